@@ -0,0 +1,6 @@
+10 A=1234:B=-56
+20 PRINT A+B;" ";A-B;" ";A*3;" ";A/B;" ";A MOD 100
+30 PRINT ABS(B);" ";SGN(B);" ";SGN(0);" ";(A+B)*2-7/2
+40 PRINT A>B;" ";A=B;" ";A#B;" ";NOT 0;" ";1 AND 0;" ";1 OR 0
+50 C=32767:PRINT C;" ";-C;" ";C/7*7+C MOD 7
+60 END
@@ -0,0 +1,8 @@
+10 DIM A(8)
+20 FOR I=1 TO 8:A(I)=(I*37) MOD 11:NEXT I
+30 FOR I=1 TO 7:FOR J=1 TO 8-I
+40 IF A(J)<=A(J+1) THEN 60
+50 T=A(J):A(J)=A(J+1):A(J+1)=T
+60 NEXT J:NEXT I
+70 FOR I=1 TO 8:PRINT A(I);" ";:NEXT I:PRINT
+80 END
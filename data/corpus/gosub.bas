@@ -0,0 +1,10 @@
+10 N=1:F=1
+20 GOSUB 100
+30 N=N+1:IF N<8 THEN 20
+40 PRINT "DONE"
+50 END
+100 F=F*N
+110 GOSUB 200
+120 RETURN
+200 PRINT N;"! = ";F
+210 RETURN
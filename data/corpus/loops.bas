@@ -0,0 +1,9 @@
+10 FOR I=1 TO 3
+20 FOR J=10 TO 1 STEP -4
+30 PRINT I*J;" ";
+40 NEXT J
+50 PRINT
+60 NEXT I
+70 FOR K=0 TO 20 STEP 7:PRINT K;" ";:NEXT K
+80 PRINT
+90 END
@@ -0,0 +1,10 @@
+10 DIM A$(40),B$(10)
+20 A$="HELLO":B$="WORLD"
+30 PRINT A$;", ";B$;" ";LEN(A$)
+40 A$(LEN(A$)+1)=" THERE"
+50 PRINT A$;" ";LEN(A$)
+60 PRINT A$(1,4);"|";A$(7);"|";A$(3,3)
+70 IF A$(1,5)="HELLO" THEN PRINT "MATCH"
+80 IF B$#"WORLD" THEN PRINT "WRONG"
+90 FOR I=1 TO LEN(B$):PRINT B$(I,I);"-";:NEXT I:PRINT
+100 END
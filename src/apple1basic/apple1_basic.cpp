@@ -20,140 +20,272 @@
  THE SOFTWARE.
 */
 
-#include <cassert>
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
 #include <cstdio>
-#include <sys/stat.h>
-
-#ifdef _WIN32
-#include <io.h>
-#endif
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #include "../netlist_6502.hpp"
-#include "apple1_basic_bin.hpp"
-#include "../utils/array_list.hpp"
+#include "../netlist_6502_shared.hpp"
+#include "apple1_basic_loader.hpp"
+#include "apple1_machine.hpp"
+#include "apple1_terminal.hpp"
 
-static std::uint8_t memory [0x10000];
-static netlist_6502 nlsym;
+/*
+ * the export is refreshed every this many half cycles, a few hundred
+ * times a second, often enough to watch and a small part of the time
+ * a half cycle takes
+ */
+static constexpr std::uint64_t publish_half_cycles = 64u;
 
-void
-charout (netlist_6502& nlsym, char ch)
+static bool
+read_file (const char* path, std::string& text)
 {
-	auto S = (uint8_t)nlsym.s();
-	auto a = 1 + memory [0x0100 + S + 1] | memory [0x0100 + ((S + 2) & 0xFF)] << 8;
-
-	/*
-	 * Apple I BASIC prints every character received
-	 * from the terminal. UNIX terminals do this
-	 * anyway, so we have to avoid printing every
-	 * line again
-	 */
-	if (a == 0xe2a6)	/* character echo */
-		return;
-	if (a == 0xe2b6)	/* CR echo */
-		return;
-
-	/*
-	 * Apple I BASIC prints a line break and 6 spaces
-	 * after every 37 characters. UNIX terminals do
-	 * line breaks themselves, so ignore these
-	 * characters
-	 */
-	if (a == 0xe025 && (ch == 10 || ch == ' '))
-		return;
-
-	/* INPUT */
-	if (a == 0xe182)
-	{
-	#if _WIN32
-		if (!isatty (0))
-			return;
-	#else
-		struct stat st;
-		fstat (0, &st);
-		if (S_ISFIFO (st.st_mode))
-			return;
-	#endif
-	}
-//#endif
-
-	putc (ch, stdout);
-	fflush (stdout);
+	auto* file = std::fopen (path, "rb");
+	if (!file)
+		return false;
+	char buffer [4096];
+	for (std::size_t read; (read = std::fread (buffer, 1, sizeof (buffer), file)) != 0;)
+		text.append (buffer, read);
+	std::fclose (file);
+	return true;
 }
 
-void
-handle_monitor (netlist_6502& nlsym)
+/*
+ * A key log holds every key with the half cycle it was typed at and the
+ * one BASIC read it at, one per line after a header, then the half cycle
+ * the input ended at:
+ *
+ *	apple1 keys 1 piped 0
+ *	12000 12345 52
+ *	end 67890
+ *
+ * A key is there for the keyboard status reads that poll for a break from
+ * the half cycle it is typed at, so a replay types it at that one.
+ */
+struct logged_key
+{
+	std::uint64_t typed;
+	std::uint64_t read;
+	char value;
+};
+
+static bool
+read_keys (const char* path, std::vector<logged_key>& keys, bool& piped, std::uint64_t& end)
 {
-	auto a = nlsym.address();
-	if (nlsym.read())
+	auto* file = std::fopen (path, "r");
+	if (!file)
+		return false;
+	int piped_flag = 0;
+	bool valid = std::fscanf (file, "apple1 keys 1 piped %d", &piped_flag) == 1;
+	piped = piped_flag != 0;
+	end = UINT64_MAX;
+	for (char word [32]; valid && std::fscanf (file, "%31s", word) == 1;)
 	{
-		nlsym.data(memory [a]);
-		if ((a & 0xFF1F) == 0xD010)
+		if (!std::strcmp (word, "end"))
 		{
-			auto c = getchar ();
-			if (c == 10)
-				c = 13;
-			c |= 0x80;
-			nlsym.data(c);
+			valid = std::fscanf (file, "%" SCNu64, &end) == 1;
+			break;
 		}
-		if ((a & 0xFF1F) == 0xD011)
+		unsigned value = 0u;
+		logged_key key {};
+		valid = std::sscanf (word, "%" SCNu64, &key.typed) == 1
+			&& std::fscanf (file, "%" SCNu64 " %x", &key.read, &value) == 2 && value < 0x100u;
+		key.value = char (value);
+		keys.push_back (key);
+	}
+	std::fclose (file);
+	return valid;
+}
+
+/*
+ * apple1_basic [-s shared memory name] [-r key log | -p key log] [program]
+ *
+ * -s exports the machine to other processes, a program is put straight
+ * into memory once BASIC is up, its lines without a number are typed in
+ * after it, before the terminal. The end of the input ends the run.
+ *
+ * -r writes every key to a key log, -p types the keys of one in place of
+ * the terminal and fails if BASIC reads one at another half cycle than it
+ * did when recorded. Give a replay the program of the recording.
+ */
+int main (int argc, char** argv)
+{
+	const char* shared_name = nullptr;
+	const char* program = nullptr;
+	const char* record_path = nullptr;
+	const char* replay_path = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!std::strcmp (argv [i], "-s") && i + 1 < argc)
+			shared_name = argv [++i];
+		else if (!std::strcmp (argv [i], "-r") && i + 1 < argc)
+			record_path = argv [++i];
+		else if (!std::strcmp (argv [i], "-p") && i + 1 < argc)
+			replay_path = argv [++i];
+		else
+			program = argv [i];
+	}
+
+	/* set when the machine is exported, the guest memory then lives in it */
+	std::unique_ptr<netlist_6502_shared> shared;
+	if (shared_name)
+	{
+		shared = netlist_6502_shared::create (shared_name, 0x10000u);
+		if (!shared)
 		{
-			if (nlsym.pc() == 0xE006)
-				/* if the code is reading a character, we have one ready */
-				nlsym.data(0x80);
+			if (errno == EEXIST)
+				std::fprintf (stderr, "shared memory %s already exists, another machine uses the name or left it behind\n", shared_name);
 			else
-				/* if the code checks for a STOP condition, nothing is pressed */
-				nlsym.data(0);
+				std::fprintf (stderr, "cannot create shared memory %s\n", shared_name);
+			return 1;
 		}
-		if ((a & 0xFF1F) == 0xD012)
-			/* 0x80 would mean we're not yet ready to receive a character */
-			nlsym.data(0);
 	}
-	else
+
+	std::string source;
+	if (program && !read_file (program, source))
+	{
+		std::fprintf (stderr, "cannot read %s\n", program);
+		return 1;
+	}
+
+	apple1_terminal terminal;
+	apple1_machine_options options;
+	options.piped_input = terminal.piped ();
+
+	/* the keys to play back, the half cycle the recording ended at */
+	std::vector<logged_key> replay;
+	std::uint64_t replay_end = UINT64_MAX;
+	if (replay_path && !read_keys (replay_path, replay, options.piped_input, replay_end))
+	{
+		std::fprintf (stderr, "cannot read key log %s\n", replay_path);
+		return 1;
+	}
+
+	std::FILE* record_file = nullptr;
+	if (record_path)
 	{
-		auto d = (uint8_t)nlsym.data();
-		memory [a] = d;
-		if ((a & 0xFF1F) == 0xD012)
+		record_file = std::fopen (record_path, "w");
+		if (!record_file)
 		{
-			auto temp8 = d & 0x7F;
-			if (temp8 == 13)
-				temp8 = 10;
-			charout (nlsym, temp8);
+			std::fprintf (stderr, "cannot write key log %s\n", record_path);
+			return 1;
 		}
+		std::fprintf (record_file, "apple1 keys 1 piped %d\n", options.piped_input ? 1 : 0);
 	}
-}
 
-void step (netlist_6502& nlsym)
-{
-	auto clk = nlsym.clock();
-	nlsym.clock(!clk);
-	nlsym.eval ();
-	if (!clk)
-		handle_monitor (nlsym);
-}
+	apple1_machine machine { options, shared ? shared->writable_memory () : nullptr };
 
-static void
-init_monitor (netlist_6502& nlsym)
-{
-	std::memset (memory, 0, sizeof (memory));
-
-	std::memcpy (&memory [0xE000], apple1_basic_bin, sizeof(apple1_basic_bin));
-	memory [0xfffc] = 0x00;
-	memory [0xfffd] = 0xE0;
-
-	/* hold RESET for 8 cycles */
-	for (int i = 0; i < 16; i++)
-		step (nlsym);
-	nlsym.reset(1);
-	/* release RESET */
-	step (nlsym);
-}
+	/* the half cycle every key was typed at and the keys BASIC read */
+	std::vector<std::uint64_t> typed;
+	std::vector<apple1_key> read;
+	if (record_file || replay_path)
+		machine.record (&read);
+	const auto type = [&] (std::string_view keys)
+	{
+		typed.insert (typed.end (), keys.size (), machine.half_cycles ());
+		machine.type (keys);
+	};
 
-int main ()
-{
-	// set up memory for user program 
-	init_monitor (nlsym);
+	if (program)
+	{
+		while (machine.run (0x10000u) != apple1_machine::status::waiting_for_key)
+			;
+		/* what doesn't fit is typed in, BASIC reports it then */
+		std::string keys;
+		if (!apple1_basic_load (machine.memory (), source, keys))
+			keys = source;
+		/* a replay has them in its log */
+		if (!replay_path)
+			type (keys);
+	}
 
-	// emulate the 6502! 
+	/* an export is also brought up to date when the machine stops to wait for a key */
+	const std::size_t quantum = 1024u;
+	auto next_publish = machine.half_cycles () + publish_half_cycles;
+	std::string output;
+	std::size_t written = 0u;
 	for (;;)
-		step (nlsym);
+	{
+		/* a replay stops at the next key to type and at the end */
+		auto run_to = replay_end;
+		if (replay_path)
+		{
+			for (; typed.size () < replay.size () && replay [typed.size ()].typed <= machine.half_cycles ();)
+				type ({ &replay [typed.size ()].value, 1u });
+			if (typed.size () < replay.size () && replay [typed.size ()].typed < run_to)
+				run_to = replay [typed.size ()].typed;
+		}
+		if (shared)
+			run_to = std::min (run_to, next_publish);
+		const auto left = run_to - machine.half_cycles ();
+		const auto status = machine.run (left < quantum ? std::size_t (left) : quantum);
+		if (shared && (machine.half_cycles () >= next_publish || status == apple1_machine::status::waiting_for_key))
+		{
+			shared->publish (machine.cpu ());
+			next_publish = machine.half_cycles () + publish_half_cycles;
+		}
+
+		machine.take_output (output);
+		for (auto ch : output)
+			terminal.write (ch);
+		output.clear ();
+
+		if (record_file && written < read.size ())
+		{
+			for (; written < read.size (); ++written)
+				std::fprintf (record_file, "%" PRIu64 " %" PRIu64 " %02x\n", typed [written],
+					read [written].half_cycle, unsigned (std::uint8_t (read [written].value)));
+			std::fflush (record_file);
+		}
+
+		if (replay_path)
+		{
+			for (; written < read.size (); ++written)
+			{
+				if (read [written].half_cycle == replay [written].read)
+					continue;
+				std::fprintf (stderr, "key %zu read at half cycle %" PRIu64 ", recorded at %" PRIu64 "\n",
+					written, read [written].half_cycle, replay [written].read);
+				return 1;
+			}
+			const bool to_type = typed.size () < replay.size () && replay [typed.size ()].typed <= machine.half_cycles ();
+			if (machine.half_cycles () < replay_end && (status != apple1_machine::status::waiting_for_key || to_type))
+				continue;
+			if (written < replay.size ())
+			{
+				std::fprintf (stderr, "input waited for at half cycle %" PRIu64 ", key %zu typed at %" PRIu64 "\n",
+					machine.half_cycles (), written, replay [written].typed);
+				return 1;
+			}
+			if (replay_end != UINT64_MAX && machine.half_cycles () != replay_end)
+			{
+				std::fprintf (stderr, "input ends at half cycle %" PRIu64 ", recorded at %" PRIu64 "\n",
+					machine.half_cycles (), replay_end);
+				return 1;
+			}
+			return 0;
+		}
+
+		if (status == apple1_machine::status::waiting_for_key)
+		{
+			const auto c = terminal.read ();
+			if (c == EOF)
+			{
+				if (record_file)
+				{
+					std::fprintf (record_file, "end %" PRIu64 "\n", machine.half_cycles ());
+					std::fclose (record_file);
+				}
+				return 0;
+			}
+			const auto key = char (c);
+			type ({ &key, 1u });
+		}
+	}
 }
@@ -0,0 +1,654 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+
+#include "../utils/array_list.hpp"
+
+/*
+ * Apple-1 BASIC keeps its program as tokenised lines from PP up to
+ * HIMEM, in ascending order, each one a length byte, the line number,
+ * the tokens and an end of line token. Variable names, the text of
+ * strings and REMs are stored as ASCII with the high bit set, numbers
+ * as their first digit followed by the 16 bit value.
+ *
+ * The token for a "," or ";" or "(" depends on the statement around it
+ * and on the type of what follows, the tokenizer follows the syntax
+ * table of the ROM for that. It only takes what it knows the ROM takes
+ * the same way, any other line is left for the keyboard, so that the
+ * ROM deals with it and reports its own errors.
+ */
+
+namespace basic_tokens
+{
+	enum : std::uint8_t
+	{
+		end_of_line						= 0x01,
+		colon									= 0x03,
+		add										= 0x12,
+		subtract							= 0x13,
+		multiply							= 0x14,
+		divide								= 0x15,
+		equal									= 0x16,
+		not_equal							= 0x17,
+		greater_equal					= 0x18,
+		greater								= 0x19,
+		less_equal						= 0x1a,
+		less_greater					= 0x1b,
+		less									= 0x1c,
+		and_									= 0x1d,
+		or_										= 0x1e,
+		mod										= 0x1f,
+		power									= 0x20,
+		dim_string_open				= 0x22,
+		slice_comma						= 0x23,
+		then_line							= 0x24,
+		then_statement				= 0x25,
+		input_comma_string		= 0x26,
+		input_comma_number		= 0x27,
+		quote_open						= 0x28,
+		quote_close						= 0x29,
+		slice_open						= 0x2a,
+		subscript_open				= 0x2d,
+		peek									= 0x2e,
+		rnd										= 0x2f,
+		sgn										= 0x30,
+		abs										= 0x31,
+		dim_number_open				= 0x34,
+		unary_plus						= 0x35,
+		unary_minus						= 0x36,
+		not_									= 0x37,
+		paren_open						= 0x38,
+		string_equal					= 0x39,
+		string_not_equal			= 0x3a,
+		len										= 0x3b,
+		function_open					= 0x3f,
+		dollar								= 0x40,
+		string_store_open			= 0x42,
+		dim_comma_string			= 0x43,
+		dim_comma_number			= 0x44,
+		print_semicolon_string	= 0x45,
+		print_semicolon_number	= 0x46,
+		print_semicolon_end		= 0x47,
+		print_comma_string		= 0x48,
+		print_comma_number		= 0x49,
+		call									= 0x4d,
+		dim_string						= 0x4e,
+		dim_number						= 0x4f,
+		tab										= 0x50,
+		end										= 0x51,
+		input_string					= 0x52,
+		input_prompt					= 0x53,
+		input_number					= 0x54,
+		for_									= 0x55,
+		for_equal							= 0x56,
+		to										= 0x57,
+		step									= 0x58,
+		next									= 0x59,
+		next_comma						= 0x5a,
+		return_								= 0x5b,
+		gosub									= 0x5c,
+		rem										= 0x5d,
+		let										= 0x5e,
+		goto_									= 0x5f,
+		if_										= 0x60,
+		print_string					= 0x61,
+		print_number					= 0x62,
+		print_empty						= 0x63,
+		poke									= 0x64,
+		poke_comma						= 0x65,
+		let_string						= 0x70,
+		let_number						= 0x71,
+		close									= 0x72
+	};
+}
+
+/* a stored program line, length byte and end of line included */
+using apple1_basic_line = array_list<std::uint8_t, 256u>;
+
+struct apple1_basic_tokenizer
+{
+	enum class value_type { none, number, string };
+
+	/* tokenizes one numbered source line, false for anything the ROM should see */
+	static auto tokenize (std::string_view source, apple1_basic_line& line) -> bool
+	{
+		apple1_basic_tokenizer tokenizer { source, line };
+		return tokenizer.parse_line ();
+	}
+
+private:
+
+	apple1_basic_tokenizer (std::string_view source, apple1_basic_line& line)
+	: text	{ source },
+		out		{ line }
+	{}
+
+	std::string_view text;
+	std::size_t at { 0u };
+	apple1_basic_line& out;
+	bool overflow { false };
+
+	auto peek () -> char
+	{
+		while (at < text.size () && text [at] == ' ')
+			++at;
+		return at < text.size () ? text [at] : '\0';
+	}
+
+	static bool is_digit (char c) { return c >= '0' && c <= '9'; }
+	static bool is_letter (char c) { return c >= 'A' && c <= 'Z'; }
+
+	/* takes the keyword or operator if it comes next, as typed, without spaces inside */
+	bool accept (std::string_view word)
+	{
+		peek ();
+		if (text.substr (at, word.size ()) != word)
+			return false;
+		at += word.size ();
+		return true;
+	}
+
+	bool accept (std::string_view word, std::uint8_t token)
+	{
+		if (!accept (word))
+			return false;
+		emit (token);
+		return true;
+	}
+
+	void emit (std::uint8_t token)
+	{
+		if (out.size () < out.capacity ())
+			out.push (token);
+		else
+			overflow = true;
+	}
+
+	bool at_statement_end ()
+	{
+		const auto c = peek ();
+		return c == '\0' || c == ':';
+	}
+
+	/* decimal up to 32767 */
+	bool scan_number (std::uint16_t& value)
+	{
+		if (!is_digit (peek ()))
+			return false;
+		std::uint32_t result = 0u;
+		while (at < text.size () && is_digit (text [at]))
+		{
+			result = result * 10u + std::uint32_t (text [at++] - '0');
+			if (result > 32767u)
+				return false;
+		}
+		value = std::uint16_t (result);
+		return true;
+	}
+
+	/* stored as its first digit and the value */
+	bool parse_number ()
+	{
+		std::uint16_t value;
+		if (!is_digit (peek ()))
+			return false;
+		emit (std::uint8_t (text [at] | 0x80u));
+		if (!scan_number (value))
+			return false;
+		emit (std::uint8_t (value));
+		emit (std::uint8_t (value >> 8u));
+		return true;
+	}
+
+	/* a letter, optionally followed by a digit, and a "$" for strings */
+	auto parse_name () -> value_type
+	{
+		if (!is_letter (peek ()))
+			return value_type::none;
+		emit (std::uint8_t (text [at++] | 0x80u));
+		if (at < text.size () && is_digit (text [at]))
+			emit (std::uint8_t (text [at++] | 0x80u));
+		if (accept ("$", basic_tokens::dollar))
+			return value_type::string;
+		return value_type::number;
+	}
+
+	bool parse_string_literal ()
+	{
+		if (!accept ("\"", basic_tokens::quote_open))
+			return false;
+		while (at < text.size () && text [at] != '"')
+			emit (std::uint8_t (text [at++] | 0x80u));
+		if (at == text.size ())
+			return false;
+		++at;
+		emit (basic_tokens::quote_close);
+		return true;
+	}
+
+	bool parse_close ()
+	{
+		return accept (")", basic_tokens::close);
+	}
+
+	/* a string variable or slice, or a literal */
+	auto parse_string () -> bool
+	{
+		if (peek () == '"')
+			return parse_string_literal ();
+		if (parse_name () != value_type::string)
+			return false;
+		if (!accept ("(", basic_tokens::slice_open))
+			return true;
+		if (parse_expression () != value_type::number)
+			return false;
+		if (accept (",", basic_tokens::slice_comma) && parse_expression () != value_type::number)
+			return false;
+		return parse_close ();
+	}
+
+	/* a string variable comes next, the type of a name is only known at its end */
+	bool string_ahead ()
+	{
+		const auto c = peek ();
+		if (c == '"')
+			return true;
+		if (!is_letter (c))
+			return false;
+		auto end = at + 1u;
+		if (end < text.size () && is_digit (text [end]))
+			++end;
+		return end < text.size () && text [end] == '$';
+	}
+
+	/* an operand with at most one unary operator, strings only as far as a comparison */
+	auto parse_operand () -> value_type
+	{
+		if (!accept ("+", basic_tokens::unary_plus) && !accept ("-", basic_tokens::unary_minus))
+			accept ("NOT", basic_tokens::not_);
+
+		const auto c = peek ();
+		if (is_digit (c))
+			return parse_number () ? value_type::number : value_type::none;
+		if (accept ("(", basic_tokens::paren_open))
+			return parse_expression () == value_type::number && parse_close () ? value_type::number : value_type::none;
+		if (accept ("LEN(", basic_tokens::len))
+			return parse_string () && parse_close () ? value_type::number : value_type::none;
+
+		static constexpr struct { std::string_view name; std::uint8_t token; } functions [] = {
+			{ "ABS(", basic_tokens::abs }, { "SGN(", basic_tokens::sgn }, 
+			{ "RND(", basic_tokens::rnd }, { "PEEK(", basic_tokens::peek }
+		};
+		for (auto&& function : functions)
+		{
+			if (!accept (function.name))
+				continue;
+			emit (function.token);
+			emit (basic_tokens::function_open);
+			return parse_expression () == value_type::number && parse_close () ? value_type::number : value_type::none;
+		}
+
+		if (string_ahead ())
+		{
+			if (!parse_string ())
+				return value_type::none;
+			if (!accept ("=", basic_tokens::string_equal) && !accept ("#", basic_tokens::string_not_equal))
+				return value_type::string;
+			return parse_string () ? value_type::number : value_type::none;
+		}
+
+		if (parse_name () != value_type::number)
+			return value_type::none;
+		if (accept ("(", basic_tokens::subscript_open))
+			return parse_expression () == value_type::number && parse_close () ? value_type::number : value_type::none;
+		return value_type::number;
+	}
+
+	auto parse_expression () -> value_type
+	{
+		static constexpr struct { std::string_view name; std::uint8_t token; } operators [] = {
+			{ ">=", basic_tokens::greater_equal }, { "<=", basic_tokens::less_equal }, 
+			{ "<>", basic_tokens::less_greater }, { ">", basic_tokens::greater }, 
+			{ "<", basic_tokens::less }, { "=", basic_tokens::equal }, 
+			{ "#", basic_tokens::not_equal }, { "+", basic_tokens::add }, 
+			{ "-", basic_tokens::subtract }, { "*", basic_tokens::multiply }, 
+			{ "/", basic_tokens::divide }, { "^", basic_tokens::power }, 
+			{ "AND", basic_tokens::and_ }, { "OR", basic_tokens::or_ }, 
+			{ "MOD", basic_tokens::mod }
+		};
+
+		auto type = parse_operand ();
+		if (type != value_type::number)
+			return type;
+		for (;;)
+		{
+			auto matched = false;
+			for (auto&& op : operators)
+				if ((matched = accept (op.name, op.token)))
+					break;
+			if (!matched)
+				return value_type::number;
+			if (parse_operand () != value_type::number)
+				return value_type::none;
+		}
+	}
+
+	bool parse_number_expression ()
+	{
+		return parse_expression () == value_type::number;
+	}
+
+	/* a variable without subscript or slice */
+	auto parse_variable () -> value_type
+	{
+		const auto type = parse_name ();
+		return peek () == '(' ? value_type::none : type;
+	}
+
+	bool parse_assignment ()
+	{
+		switch (parse_name ())
+		{
+		case value_type::number:
+			if (accept ("(", basic_tokens::subscript_open) && !(parse_number_expression () && parse_close ()))
+				return false;
+			return accept ("=", basic_tokens::let_number) && parse_number_expression ();
+
+		case value_type::string:
+			if (accept ("(", basic_tokens::string_store_open) && !(parse_number_expression () && parse_close ()))
+				return false;
+			return accept ("=", basic_tokens::let_string) && parse_string ();
+
+		default:
+			return false;
+		}
+	}
+
+	bool parse_print ()
+	{
+		auto token_at = out.size ();
+		emit (basic_tokens::print_empty);
+		if (at_statement_end ())
+			return true;
+
+		for (auto first = true;; first = false)
+		{
+			/* an item that starts with a string is a string, never a comparison */
+			const auto type = string_ahead () 
+				? (parse_string () ? value_type::string : value_type::none) 
+				: parse_expression ();
+			if (type == value_type::none)
+				return false;
+			if (token_at < out.size ())
+			{
+				if (first)
+					out [token_at] = type == value_type::string ? basic_tokens::print_string : basic_tokens::print_number;
+				else if (out [token_at] == basic_tokens::print_semicolon_end)
+					out [token_at] = type == value_type::string ? basic_tokens::print_semicolon_string : basic_tokens::print_semicolon_number;
+				else
+					out [token_at] = type == value_type::string ? basic_tokens::print_comma_string : basic_tokens::print_comma_number;
+			}
+			if (at_statement_end ())
+				return true;
+
+			token_at = out.size ();
+			if (accept (";", basic_tokens::print_semicolon_end))
+			{
+				if (at_statement_end ())
+					return true;
+			}
+			/* the ROM doesn't take a "," at the end */
+			else if (!accept (",", basic_tokens::print_comma_number))
+				return false;
+		}
+	}
+
+	bool parse_input ()
+	{
+		auto token_at = out.size ();
+		auto first = true;
+		if (peek () == '"')
+		{
+			emit (basic_tokens::input_prompt);
+			if (!parse_string_literal ())
+				return false;
+			token_at = out.size ();
+			if (!accept (",", basic_tokens::input_comma_number))
+				return false;
+			first = false;
+		}
+		else
+			emit (basic_tokens::input_number);
+
+		for (;; first = false)
+		{
+			const auto type = parse_variable ();
+			if (type == value_type::none)
+				return false;
+			if (token_at < out.size ())
+			{
+				if (first)
+					out [token_at] = type == value_type::string ? basic_tokens::input_string : basic_tokens::input_number;
+				else
+					out [token_at] = type == value_type::string ? basic_tokens::input_comma_string : basic_tokens::input_comma_number;
+			}
+			if (at_statement_end ())
+				return true;
+			token_at = out.size ();
+			if (!accept (",", basic_tokens::input_comma_number))
+				return false;
+		}
+	}
+
+	bool parse_dim ()
+	{
+		auto token_at = out.size ();
+		emit (basic_tokens::dim_number);
+		for (auto first = true;; first = false)
+		{
+			const auto type = parse_name ();
+			if (type == value_type::none)
+				return false;
+			if (token_at < out.size ())
+			{
+				if (first)
+					out [token_at] = type == value_type::string ? basic_tokens::dim_string : basic_tokens::dim_number;
+				else
+					out [token_at] = type == value_type::string ? basic_tokens::dim_comma_string : basic_tokens::dim_comma_number;
+			}
+			if (!accept ("(", type == value_type::string ? basic_tokens::dim_string_open : basic_tokens::dim_number_open) || 
+				!parse_number_expression () || !parse_close ())
+				return false;
+			if (at_statement_end ())
+				return true;
+			token_at = out.size ();
+			if (!accept (",", basic_tokens::dim_comma_number))
+				return false;
+		}
+	}
+
+	bool parse_statement ()
+	{
+		if (accept ("REM", basic_tokens::rem))
+		{
+			/* the rest of the line as typed, spaces included */
+			while (at < text.size ())
+				emit (std::uint8_t (text [at++] | 0x80u));
+			return true;
+		}
+		if (accept ("LET", basic_tokens::let))
+			return parse_assignment ();
+		if (accept ("PRINT"))
+			return parse_print ();
+		if (accept ("INPUT"))
+			return parse_input ();
+		if (accept ("DIM"))
+			return parse_dim ();
+		if (accept ("IF", basic_tokens::if_))
+		{
+			if (!parse_number_expression () || !accept ("THEN"))
+				return false;
+			/* a line number, never an expression */
+			if (is_digit (peek ()))
+			{
+				emit (basic_tokens::then_line);
+				return parse_number ();
+			}
+			emit (basic_tokens::then_statement);
+			return parse_statement ();
+		}
+		if (accept ("FOR", basic_tokens::for_))
+			return parse_variable () == value_type::number &&
+				accept ("=", basic_tokens::for_equal) && parse_number_expression () && 
+				accept ("TO", basic_tokens::to) && parse_number_expression () &&
+				(!accept ("STEP", basic_tokens::step) || parse_number_expression ());
+		if (accept ("NEXT", basic_tokens::next))
+		{
+			do
+			{
+				if (parse_variable () != value_type::number)
+					return false;
+			}
+			while (accept (",", basic_tokens::next_comma));
+			return true;
+		}
+		if (accept ("POKE", basic_tokens::poke))
+			return parse_number_expression () && accept (",", basic_tokens::poke_comma) && parse_number_expression ();
+		if (accept ("GOTO", basic_tokens::goto_) || accept ("GOSUB", basic_tokens::gosub) || 
+			accept ("CALL", basic_tokens::call) || accept ("TAB", basic_tokens::tab))
+			return parse_number_expression ();
+		if (accept ("RETURN", basic_tokens::return_) || accept ("END", basic_tokens::end))
+			return true;
+		return parse_assignment ();
+	}
+
+	bool parse_line ()
+	{
+		std::uint16_t number;
+		if (text.size () > 120u || !scan_number (number) || number == 0u)
+			return false;
+		out.clear ();
+		emit (0u);
+		emit (std::uint8_t (number));
+		emit (std::uint8_t (number >> 8u));
+
+		do
+		{
+			if (!parse_statement ())
+				return false;
+		}
+		while (accept (":", basic_tokens::colon));
+
+		if (peek () != '\0')
+			return false;
+		emit (basic_tokens::end_of_line);
+		if (overflow || out.size () > 255u)
+			return false;
+		out [0] = std::uint8_t (out.size ());
+		return true;
+	}
+};
+
+/* zero page pointers of BASIC */
+static inline constexpr std::uint16_t apple1_basic_lomem	= 0x004a;
+static inline constexpr std::uint16_t apple1_basic_himem	= 0x004c;
+static inline constexpr std::uint16_t apple1_basic_pp			= 0x00ca;
+static inline constexpr std::uint16_t apple1_basic_pv			= 0x00cc;
+
+/*
+ * Replaces the program of a BASIC waiting for input with the numbered
+ * lines of a source text, and appends everything the tokenizer leaves
+ * alone to keys, in order, to be typed in after. That is every line
+ * without a number and every line with the number of a line it didn't
+ * take, so the last line for a number still wins. False, with memory
+ * untouched, when the program doesn't fit above the variables.
+ */
+static inline auto
+apple1_basic_load (std::uint8_t* memory, std::string_view source, std::string& keys) -> bool
+{
+	const auto lines = [source] (auto&& visit) {
+		for (std::size_t begin = 0u; begin < source.size ();)
+		{
+			auto end = std::min (source.find ('\n', begin), source.size ());
+			auto line = source.substr (begin, end - begin);
+			if (!line.empty () && line.back () == '\r')
+				line.remove_suffix (1u);
+			visit (line);
+			begin = end + 1u;
+		}
+	};
+	const auto number_of = [] (std::string_view line) {
+		std::uint32_t number = 0u;
+		for (auto c : line.substr (0u, std::min (line.find_first_not_of ("0123456789 "), line.size ())))
+			if (c != ' ')
+				number = std::min (number * 10u + std::uint32_t (c - '0'), 0x10000u);
+		return number;
+	};
+
+	apple1_basic_line tokens;
+	std::set<std::uint32_t> typed;
+	lines ([&] (std::string_view line) {
+		if (!apple1_basic_tokenizer::tokenize (line, tokens))
+			typed.insert (number_of (line));
+	});
+
+	std::map<std::uint16_t, apple1_basic_line> program;
+	std::string rest;
+	lines ([&] (std::string_view line) {
+		if (!typed.contains (number_of (line)) && apple1_basic_tokenizer::tokenize (line, tokens))
+		{
+			const auto number = std::uint16_t (tokens [1] | tokens [2] << 8u);
+			program.erase (number);
+			program.emplace (number, tokens);
+		}
+		else if (line.find_first_not_of (' ') != line.npos)
+			(rest += line) += '\n';
+	});
+
+	const auto word = [memory] (std::uint16_t address) { return std::uint16_t (memory [address] | memory [address + 1u] << 8u); };
+	std::size_t size = 0u;
+	for (auto&& [number, line] : program)
+		size += line.size ();
+	/* a corrupted zero page must not wrap the difference around */
+	const auto himem = word (apple1_basic_himem);
+	const auto pv = word (apple1_basic_pv);
+	if (pv > himem || size > std::size_t (himem - pv))
+		return false;
+
+	auto pp = std::uint16_t (himem - size);
+	memory [apple1_basic_pp] = std::uint8_t (pp);
+	memory [apple1_basic_pp + 1u] = std::uint8_t (pp >> 8u);
+	for (auto&& [number, line] : program)
+		for (auto byte : line)
+			memory [pp++] = byte;
+
+	keys += rest;
+	return true;
+}
@@ -0,0 +1,309 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+/*
+ * Runs the BASIC programs of a corpus, checks what they print against
+ * their golden output byte for byte and writes how fast every one ran.
+ *
+ * The corpus directory holds a corpus.txt, one program per line with the
+ * half-cycles it may take at most, and for every program name.bas and its
+ * golden output name.out. A program is put into memory, then RUN is typed
+ * and it runs until BASIC waits for a key again. Its output is everything
+ * the machine printed from reset on, its half-cycles and its time count
+ * from RUN on, so booting BASIC doesn't weigh on its speed.
+ *
+ *   apple1_corpus [-j jobs] [-o results] [-g] corpus
+ *   apple1_corpus -c baseline results [-t percent]
+ *
+ * -g writes the golden outputs instead of checking them. -c compares two
+ * results files: a program whose half-cycle count changed behaves
+ * differently, and with -t one that got more than that many percent
+ * slower fails too.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "apple1_basic_loader.hpp"
+#include "apple1_machine.hpp"
+
+struct corpus_program
+{
+	std::string name;
+	std::uint64_t budget { 0u };
+
+	/* filled in by the run */
+	const char* status { "missing" };
+	std::uint64_t half_cycles { 0u };
+	double seconds { 0.0 };
+};
+
+struct corpus_result
+{
+	std::string name;
+	std::string status;
+	std::uint64_t half_cycles { 0u };
+	double seconds { 0.0 };
+	double rate { 0.0 };
+};
+
+static bool
+read_file (const std::string& path, std::string& text)
+{
+	auto* file = std::fopen (path.c_str (), "rb");
+	if (!file)
+		return false;
+	char buffer [4096];
+	for (std::size_t read; (read = std::fread (buffer, 1, sizeof (buffer), file)) != 0;)
+		text.append (buffer, read);
+	std::fclose (file);
+	return true;
+}
+
+static bool
+write_file (const std::string& path, const std::string& text)
+{
+	auto* file = std::fopen (path.c_str (), "wb");
+	if (!file)
+		return false;
+	const auto written = std::fwrite (text.data (), 1, text.size (), file);
+	return std::fclose (file) == 0 && written == text.size ();
+}
+
+static void
+run_program (const std::string& corpus, corpus_program& program, bool golden)
+{
+	std::string source, expected;
+	const auto path = corpus + "/" + program.name;
+	if (!read_file (path + ".bas", source) || (!golden && !read_file (path + ".out", expected)))
+		return;
+
+	apple1_machine machine { { .local_echo = true, .piped_input = true } };
+	while (machine.run (0x10000u) != apple1_machine::status::waiting_for_key)
+		;
+	std::string keys;
+	if (!apple1_basic_load (machine.memory (), source, keys))
+		keys = source;
+	machine.type (keys);
+	machine.type ("RUN\n");
+
+	/* a program that doesn't end within its budget has gone wrong */
+	const auto start = std::chrono::steady_clock::now ();
+	const auto ready = machine.half_cycles ();
+	auto status = apple1_machine::status::running;
+	while (status != apple1_machine::status::waiting_for_key && machine.half_cycles () - ready <= program.budget)
+	{
+		const auto left = program.budget + 1u - (machine.half_cycles () - ready);
+		status = machine.run (std::size_t (std::min<std::uint64_t> (left, 0x1000u)));
+	}
+	const auto stop = std::chrono::steady_clock::now ();
+	program.half_cycles = machine.half_cycles () - ready;
+	program.status = program.half_cycles > program.budget ? "budget" : "ok";
+	program.seconds = std::chrono::duration<double> (stop - start).count ();
+
+	std::string output;
+	machine.take_output (output);
+	if (golden && !write_file (path + ".out", output))
+		program.status = "missing";
+	else if (!golden && output != expected && program.status == std::string_view { "ok" })
+		program.status = "output";
+}
+
+static bool
+read_corpus (const std::string& corpus, std::vector<corpus_program>& programs)
+{
+	std::string text;
+	if (!read_file (corpus + "/corpus.txt", text))
+		return false;
+	for (std::size_t at = 0u; at < text.size ();)
+	{
+		auto end = text.find ('\n', at);
+		if (end == std::string::npos)
+			end = text.size ();
+		const auto line = text.substr (at, end - at);
+		at = end + 1u;
+
+		char name [256];
+		unsigned long long budget;
+		if (line.empty () || line [0] == '#' || std::sscanf (line.c_str (), "%255s %llu", name, &budget) != 2)
+			continue;
+		programs.push_back ({ name, budget });
+	}
+	return true;
+}
+
+static bool
+read_results (const char* path, std::vector<corpus_result>& results)
+{
+	auto* file = std::fopen (path, "r");
+	if (!file)
+		return false;
+	char name [256], status [32];
+	unsigned long long half_cycles;
+	corpus_result result;
+	int version { 0 };
+	bool valid = std::fscanf (file, "apple1 corpus results %d", &version) == 1 && version == 1;
+	while (valid && std::fscanf (file, "%255s %31s %llu %lf %lf", name, status, &half_cycles, &result.seconds, &result.rate) == 5)
+	{
+		result.name = name;
+		result.status = status;
+		result.half_cycles = half_cycles;
+		results.push_back (result);
+	}
+	valid &= std::feof (file) != 0;
+	std::fclose (file);
+	return valid;
+}
+
+static int
+compare (const char* baseline_path, const char* results_path, double threshold)
+{
+	std::vector<corpus_result> baseline, results;
+	if (!read_results (baseline_path, baseline) || !read_results (results_path, results))
+	{
+		std::fprintf (stderr, "cannot read %s or %s\n", baseline_path, results_path);
+		return EXIT_FAILURE;
+	}
+
+	int result { EXIT_SUCCESS };
+	double log_sum { 0.0 };
+	std::size_t compared { 0u };
+	for (auto&& current : results)
+	{
+		const corpus_result* base = nullptr;
+		for (auto&& candidate : baseline)
+			if (candidate.name == current.name)
+				base = &candidate;
+
+		if (!base || current.status != "ok" || base->status != "ok")
+		{
+			std::printf ("%-16s %s\n", current.name.c_str (), 
+				!base ? "not in the baseline" : current.status != "ok" ? current.status.c_str () : "baseline failed");
+			if (current.status != "ok")
+				result = EXIT_FAILURE;
+			continue;
+		}
+
+		const auto change = (current.rate / base->rate - 1.0) * 100.0;
+		const bool differs = current.half_cycles != base->half_cycles;
+		const bool slower = threshold >= 0.0 && change < -threshold;
+		std::printf ("%-16s %12.0f -> %12.0f half-cycles/s %+7.2f %%%s%s\n", current.name.c_str (), 
+			base->rate, current.rate, change, differs ? "   half-cycles differ" : "", slower ? "   slower" : "");
+		if (differs || slower)
+			result = EXIT_FAILURE;
+		log_sum += std::log (current.rate / base->rate);
+		++compared;
+	}
+	if (compared)
+		std::printf ("geometric mean %+7.2f %%\n", (std::exp (log_sum / double (compared)) - 1.0) * 100.0);
+	return result;
+}
+
+int main (int argc, char** argv)
+{
+	const char* corpus = nullptr;
+	const char* results_path = nullptr;
+	const char* baseline_path = nullptr;
+	auto jobs = std::max (1u, std::thread::hardware_concurrency ());
+	double threshold { -1.0 };
+	bool golden { false };
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!std::strcmp (argv [i], "-j") && i + 1 < argc)
+			jobs = unsigned (std::max (1, std::atoi (argv [++i])));
+		else if (!std::strcmp (argv [i], "-o") && i + 1 < argc)
+			results_path = argv [++i];
+		else if (!std::strcmp (argv [i], "-c") && i + 1 < argc)
+			baseline_path = argv [++i];
+		else if (!std::strcmp (argv [i], "-t") && i + 1 < argc)
+			threshold = std::atof (argv [++i]);
+		else if (!std::strcmp (argv [i], "-g"))
+			golden = true;
+		else
+			corpus = argv [i];
+	}
+
+	if (baseline_path)
+	{
+		if (!corpus)
+		{
+			std::fprintf (stderr, "usage: apple1_corpus -c baseline results [-t percent]\n");
+			return EXIT_FAILURE;
+		}
+		return compare (baseline_path, corpus, threshold);
+	}
+
+	std::vector<corpus_program> programs;
+	if (!corpus || !read_corpus (corpus, programs))
+	{
+		std::fprintf (stderr, "usage: apple1_corpus [-j jobs] [-o results] [-g] corpus\n");
+		return EXIT_FAILURE;
+	}
+
+	/* every worker takes the next program that nobody runs yet */
+	std::atomic<std::size_t> next { 0u };
+	std::vector<std::thread> workers;
+	for (unsigned i = 0u; i < std::min<std::size_t> (jobs, programs.size ()); ++i)
+	{
+		workers.emplace_back ([&]
+		{
+			for (std::size_t p; (p = next.fetch_add (1u)) < programs.size ();)
+				run_program (corpus, programs [p], golden);
+		});
+	}
+	for (auto&& worker : workers)
+		worker.join ();
+
+	std::FILE* results = results_path ? std::fopen (results_path, "w") : nullptr;
+	if (results_path && !results)
+	{
+		std::fprintf (stderr, "cannot write %s\n", results_path);
+		return EXIT_FAILURE;
+	}
+	if (results)
+		std::fprintf (results, "apple1 corpus results 1\n");
+
+	int result { EXIT_SUCCESS };
+	for (auto&& program : programs)
+	{
+		const auto rate = program.seconds > 0.0 ? double (program.half_cycles) / program.seconds : 0.0;
+		std::printf ("%-16s %-8s %10llu half-cycles %8.3f s %12.0f half-cycles/s\n", program.name.c_str (), 
+			program.status, (unsigned long long)program.half_cycles, program.seconds, rate);
+		if (results)
+			std::fprintf (results, "%s %s %llu %.6f %.0f\n", program.name.c_str (), 
+				program.status, (unsigned long long)program.half_cycles, program.seconds, rate);
+		if (std::strcmp (program.status, "ok"))
+			result = EXIT_FAILURE;
+	}
+	if (results)
+		std::fclose (results);
+	return result;
+}
@@ -0,0 +1,195 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include <cstring>
+
+#include "apple1_basic_bin.hpp"
+#include "apple1_machine.hpp"
+
+apple1_machine::apple1_machine (const apple1_machine_options& options, std::uint8_t* memory)
+: options			{ options },
+	nlsym				{ options.cpu },
+	own_memory	{ memory ? nullptr : new std::uint8_t [0x10000] },
+	ram					{ memory ? memory : own_memory.get () }
+{
+	std::memset (ram, 0, 0x10000);
+
+	std::memcpy (&ram [0xE000], apple1_basic_bin, sizeof(apple1_basic_bin));
+	ram [0xfffc] = 0x00;
+	ram [0xfffd] = 0xE0;
+
+	/* hold RESET for 8 cycles */
+	for (int i = 0; i < 16; i++)
+		step ();
+	nlsym.reset(1);
+	/* release RESET */
+	step ();
+}
+
+auto apple1_machine::run (std::size_t half_cycles) -> status
+{
+	for (std::size_t i = 0u; i < half_cycles; ++i)
+	{
+		if (key_pending)
+		{
+			if (keys_read == keys.size ())
+				return status::waiting_for_key;
+			/* the keyboard status read from before, now with a key ready */
+			nlsym.data(0x80);
+			key_pending = false;
+		}
+		step ();
+	}
+	return key_pending && keys_read == keys.size () ? status::waiting_for_key : status::running;
+}
+
+void apple1_machine::type (std::string_view text)
+{
+	/* drop what has been read once it is all read, the string never grows for long */
+	if (keys_read == keys.size ())
+	{
+		keys.clear ();
+		keys_read = 0u;
+	}
+	keys.append (text);
+}
+
+auto apple1_machine::keys_waiting () const -> std::size_t
+{
+	return keys.size () - keys_read;
+}
+
+void apple1_machine::record (std::vector<apple1_key>* keys)
+{
+	recording = keys;
+}
+
+void apple1_machine::take_output (std::string& output)
+{
+	output.append (this->output);
+	this->output.clear ();
+}
+
+auto apple1_machine::cpu () -> netlist_6502&
+{
+	return nlsym;
+}
+
+auto apple1_machine::memory () -> std::uint8_t*
+{
+	return ram;
+}
+
+auto apple1_machine::half_cycles () const -> std::uint64_t
+{
+	return cycles;
+}
+
+void apple1_machine::step ()
+{
+	auto clk = nlsym.clock();
+	nlsym.clock(!clk);
+	nlsym.eval ();
+	++cycles;
+	if (!clk)
+		handle_monitor ();
+}
+
+void apple1_machine::charout (char ch)
+{
+	auto S = (uint8_t)nlsym.s();
+	auto a = 1 + ram [0x0100 + S + 1] | ram [0x0100 + ((S + 2) & 0xFF)] << 8;
+
+	/*
+	 * Apple I BASIC prints every character received
+	 * from the terminal. UNIX terminals do this
+	 * anyway, so we have to avoid printing every
+	 * line again
+	 */
+	if (options.local_echo && a == 0xe2a6)	/* character echo */
+		return;
+	if (options.local_echo && a == 0xe2b6)	/* CR echo */
+		return;
+
+	/*
+	 * Apple I BASIC prints a line break and 6 spaces
+	 * after every 37 characters. UNIX terminals do
+	 * line breaks themselves, so ignore these
+	 * characters
+	 */
+	if (a == 0xe025 && (ch == 10 || ch == ' '))
+		return;
+
+	/* INPUT */
+	if (a == 0xe182 && options.piped_input)
+		return;
+
+	output.push_back (ch);
+}
+
+void apple1_machine::handle_monitor ()
+{
+	auto a = nlsym.address();
+	if (nlsym.read())
+	{
+		nlsym.data(ram [a]);
+		if ((a & 0xFF1F) == 0xD010 && keys_read < keys.size ())
+		{
+			if (recording)
+				recording->push_back ({ cycles, keys [keys_read] });
+			int c = std::uint8_t (keys [keys_read++]);
+			if (c == 10)
+				c = 13;
+			c |= 0x80;
+			nlsym.data(c);
+		}
+		if ((a & 0xFF1F) == 0xD011)
+		{
+			if (nlsym.pc() == 0xE006)
+			{
+				/* if the code is reading a character, we have one ready, or it waits until we do */
+				if (keys_read < keys.size ())
+					nlsym.data(0x80);
+				else
+					key_pending = true;
+			}
+			else
+				/* if the code checks for a STOP condition, nothing is pressed */
+				nlsym.data(0);
+		}
+		if ((a & 0xFF1F) == 0xD012)
+			/* 0x80 would mean we're not yet ready to receive a character */
+			nlsym.data(0);
+	}
+	else
+	{
+		auto d = (uint8_t)nlsym.data();
+		ram [a] = d;
+		if ((a & 0xFF1F) == 0xD012)
+		{
+			auto temp8 = d & 0x7F;
+			if (temp8 == 13)
+				temp8 = 10;
+			charout (temp8);
+		}
+	}
+}
@@ -0,0 +1,107 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../netlist_6502.hpp"
+
+struct apple1_machine_options
+{
+	/* the terminal shows typed keys itself, BASIC's echo of them is dropped */
+	bool local_echo { true };
+
+	/* keys come from a file, so the prompts of INPUT are dropped too */
+	bool piped_input { false };
+
+	netlist_6502_options cpu {};
+};
+
+/* a key as BASIC read it from the keyboard, and the half cycle it did */
+struct apple1_key
+{
+	std::uint64_t half_cycle;
+	char value;
+};
+
+/*
+ * An Apple-1 with BASIC in ROM: the 6502, 64K of memory and the PIA
+ * that connects keyboard and display. It owns no terminal, keys come in
+ * through type() and whatever BASIC prints piles up for take_output(),
+ * so one process can run as many machines as it likes.
+ */
+struct apple1_machine
+{
+	enum class status 
+	{ 
+		running, 
+		waiting_for_key		/* BASIC asks for a key and none has been typed */
+	};
+
+	/* resets the machine, into memory of its own unless given 64K to use */
+	explicit apple1_machine (const apple1_machine_options& options = {}, std::uint8_t* memory = nullptr);
+
+	apple1_machine (const apple1_machine&) = delete;
+	apple1_machine& operator = (const apple1_machine&) = delete;
+
+	/* runs up to this many half cycles, stops early when BASIC waits for a key */
+	auto run (std::size_t half_cycles) -> status;
+
+	/* keys for the keyboard, after those typed before */
+	void type (std::string_view text);
+
+	/* keys typed that BASIC hasn't read yet */
+	auto keys_waiting () const -> std::size_t;
+
+	/* appends every key BASIC reads from now on to keys, null stops */
+	void record (std::vector<apple1_key>* keys);
+
+	/* appends what BASIC printed since the last call */
+	void take_output (std::string& output);
+
+	auto cpu				() -> netlist_6502&;
+	auto memory			() -> std::uint8_t*;
+	auto half_cycles	() const -> std::uint64_t;
+
+private:
+	void step ();
+	void handle_monitor ();
+	void charout (char ch);
+
+	apple1_machine_options options;
+	netlist_6502 nlsym;
+	std::unique_ptr<std::uint8_t []> own_memory;
+	std::uint8_t* ram;
+	std::uint64_t cycles { 0u };
+
+	/* the PIA, keys not read yet, and a read of the keyboard status on hold for one */
+	std::string keys;
+	std::size_t keys_read { 0u };
+	bool key_pending { false };
+	std::vector<apple1_key>* recording { nullptr };
+	std::string output;
+};
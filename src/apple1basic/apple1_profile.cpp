@@ -0,0 +1,119 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+/*
+ * Profiles Apple-1 BASIC as a guest: which ROM routines and which
+ * instructions the simulator spends its time on, and what each costs
+ * per half-cycle. A program is put into memory first if given, then the
+ * input is typed in one key whenever BASIC waits for one. The run ends
+ * when BASIC waits and the input is used up. What BASIC prints goes to
+ * stderr, the profile to stdout.
+ *
+ *   apple1_profile [-n rows] [-d depth] [program] < input
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "../netlist_6502_profile.hpp"
+#include "apple1_basic_loader.hpp"
+#include "apple1_machine.hpp"
+
+static bool
+read_file (const char* path, std::string& text)
+{
+	auto* file = std::fopen (path, "rb");
+	if (!file)
+		return false;
+	char buffer [4096];
+	for (std::size_t read; (read = std::fread (buffer, 1, sizeof (buffer), file)) != 0;)
+		text.append (buffer, read);
+	std::fclose (file);
+	return true;
+}
+
+int main (int argc, char** argv)
+{
+	const char* program = nullptr;
+	std::size_t rows { 30u };
+	std::size_t depth { 8u };
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!std::strcmp (argv [i], "-n") && i + 1 < argc)
+			rows = std::size_t (std::max (1, std::atoi (argv [++i])));
+		else if (!std::strcmp (argv [i], "-d") && i + 1 < argc)
+			depth = std::size_t (std::max (0, std::atoi (argv [++i])));
+		else
+			program = argv [i];
+	}
+
+	std::string source, input;
+	if (program && !read_file (program, source))
+	{
+		std::fprintf (stderr, "cannot read %s\n", program);
+		return EXIT_FAILURE;
+	}
+	for (int c; (c = std::getchar ()) != EOF; )
+		input.push_back (char (c));
+
+	apple1_machine machine { { .local_echo = true, .piped_input = true } };
+	netlist_6502_profile profile;
+	std::string output;
+	std::size_t typed { 0u };
+	bool loaded { !program };
+	for (;;)
+	{
+		const auto before = machine.half_cycles ();
+		const auto start = std::chrono::steady_clock::now ();
+		const auto status = machine.run (1u);
+		const auto stop = std::chrono::steady_clock::now ();
+		if (machine.half_cycles () != before)
+			profile.sample (machine.cpu (), machine.memory (), std::chrono::duration<double> (stop - start).count ());
+
+		machine.take_output (output);
+		std::fwrite (output.data (), 1, output.size (), stderr);
+		output.clear ();
+
+		if (status == apple1_machine::status::waiting_for_key)
+		{
+			/* waiting costs nothing, the key goes in at the same half-cycle */
+			if (!loaded)
+			{
+				std::string keys;
+				if (!apple1_basic_load (machine.memory (), source, keys))
+					keys = source;
+				machine.type (keys);
+				loaded = true;
+				continue;
+			}
+			if (typed == input.size ())
+				break;
+			machine.type ({ &input [typed++], 1u });
+		}
+	}
+
+	profile.report (stdout, rows, depth);
+	return EXIT_SUCCESS;
+}
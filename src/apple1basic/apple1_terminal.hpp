@@ -0,0 +1,289 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "../utils/spsc_ring.hpp"
+
+/*
+ * The terminal of the Apple-1, stdout and stdin behind two rings. The
+ * simulation only pushes and pops, a writer thread drains the output
+ * in batches and a reader thread keeps the input topped up, so neither
+ * a character out nor a key in costs the simulation a system call.
+ *
+ * Both threads sleep until there is something to do. The reader only
+ * starts once the simulation first asks for a key, so a run that never
+ * reads the terminal leaves stdin alone. The terminal writes out what
+ * is left in the ring, stops both threads and joins them when it goes
+ * away, a reader blocked in stdin is woken for it.
+ */
+struct apple1_terminal
+{
+	apple1_terminal ()
+	: writer { [this] { drain (); } }
+	{
+	}
+
+	~apple1_terminal ()
+	{
+		if (reader.joinable ())
+			stop_reader ();
+
+		closing.store (true, std::memory_order_release);
+		output_ready.ring ();
+		writer.join ();
+	}
+
+	apple1_terminal (const apple1_terminal&) = delete;
+	apple1_terminal& operator = (const apple1_terminal&) = delete;
+
+	/* waits only while the output ring is full */
+	void write (char ch)
+	{
+		while (!output.push (ch))
+			output_space.wait ([this] { return !output.full (); });
+		output_ready.ring ();
+	}
+
+	/* the next key, waits while none has come in yet, EOF once stdin is done */
+	auto read () -> int
+	{
+		if (!reader.joinable () && !input_done.load (std::memory_order_acquire))
+			start_reader ();
+
+		for (;;)
+		{
+			char ch;
+			if (input.pop (ch))
+			{
+				input_space.ring ();
+				return static_cast<unsigned char> (ch);
+			}
+			/* the reader pushes everything before it says it is done */
+			if (input_done.load (std::memory_order_acquire) && input.empty ())
+				return EOF;
+			input_ready.wait ([this] { return !input.empty () || input_done.load (std::memory_order_acquire); });
+		}
+	}
+
+	/* whether stdin is a pipe rather than someone typing, looked up once */
+	bool piped () const 
+	{ 
+		return stdin_piped; 
+	}
+
+private:
+	/*
+	 * Wakes the one thread that waits on it. Ringing takes no lock and no
+	 * system call unless that thread is asleep: the waiter announces
+	 * itself before it checks for work, the ringer makes its work visible
+	 * before it checks for a waiter, and the fences between make sure at
+	 * least one of them sees the other.
+	 */
+	struct doorbell
+	{
+		void ring ()
+		{
+			std::atomic_thread_fence (std::memory_order_seq_cst);
+			if (waiting.load (std::memory_order_relaxed))
+			{
+				std::lock_guard guard { lock };
+				wake.notify_one ();
+			}
+		}
+
+		template <typename _Ready>
+		void wait (_Ready&& ready)
+		{
+			std::unique_lock guard { lock };
+			waiting.store (true, std::memory_order_relaxed);
+			std::atomic_thread_fence (std::memory_order_seq_cst);
+			wake.wait (guard, ready);
+			waiting.store (false, std::memory_order_relaxed);
+		}
+
+	private:
+		std::mutex lock;
+		std::condition_variable wake;
+		std::atomic<bool> waiting { false };
+	};
+
+	void drain ()
+	{
+		char batch [4096];
+		for (;;)
+		{
+			const auto closing = this->closing.load (std::memory_order_acquire);
+			if (const auto count = output.pop (batch, sizeof (batch)))
+			{
+				output_space.ring ();
+				std::fwrite (batch, 1, count, stdout);
+				std::fflush (stdout);
+			}
+			else if (closing)
+				return;
+			else
+				output_ready.wait ([this] { return !output.empty () || this->closing.load (std::memory_order_acquire); });
+		}
+	}
+
+	/* hands what came in to the simulation, false once the reader is to stop */
+	bool fill (const char* data, std::size_t count)
+	{
+		while (count)
+		{
+			const auto pushed = input.push (data, count);
+			data += pushed;
+			count -= pushed;
+			input_ready.ring ();
+			if (count)
+				input_space.wait ([this] { return !input.full () || stopping.load (std::memory_order_acquire); });
+			if (stopping.load (std::memory_order_acquire))
+				return false;
+		}
+		return true;
+	}
+
+	void finish_input ()
+	{
+		input_done.store (true, std::memory_order_release);
+		input_ready.ring ();
+	}
+
+#if defined(_WIN32)
+	/* the CRT's text mode stays in charge of line ends, a blocked read is cancelled to stop */
+	void start_reader ()
+	{
+		reader = std::thread { [this] {
+			for (int c; !stopping.load (std::memory_order_acquire) && (c = std::getchar ()) != EOF;)
+			{
+				const auto ch = char (c);
+				if (!fill (&ch, 1u))
+					break;
+			}
+			finish_input ();
+		} };
+	}
+
+	void stop_reader ()
+	{
+		stopping.store (true, std::memory_order_release);
+		input_space.ring ();
+		/* a cancel that comes before the read starts is lost, so keep at it */
+		while (!input_done.load (std::memory_order_acquire))
+		{
+			CancelSynchronousIo (reader.native_handle ());
+			std::this_thread::sleep_for (std::chrono::milliseconds (1));
+		}
+		reader.join ();
+	}
+#else
+	/* stdin is read raw, past stdio, so that polling it sees everything there is */
+	void start_reader ()
+	{
+		if (pipe (wake_pipe))
+		{
+			finish_input ();
+			return;
+		}
+		reader = std::thread { [this] {
+			char buffer [4096];
+			for (;;)
+			{
+				pollfd fds [2] { { STDIN_FILENO, POLLIN, 0 }, { wake_pipe [0], POLLIN, 0 } };
+				if (poll (fds, 2, -1) < 0)
+				{
+					if (errno == EINTR)
+						continue;
+					break;
+				}
+				if (fds [1].revents)
+					break;
+				const auto count = ::read (STDIN_FILENO, buffer, sizeof (buffer));
+				if (count <= 0 || !fill (buffer, std::size_t (count)))
+					break;
+			}
+			finish_input ();
+		} };
+	}
+
+	void stop_reader ()
+	{
+		stopping.store (true, std::memory_order_release);
+		input_space.ring ();
+		[[maybe_unused]] const auto written = ::write (wake_pipe [1], "", 1);
+		reader.join ();
+		close (wake_pipe [0]);
+		close (wake_pipe [1]);
+	}
+#endif
+
+	static bool is_piped ()
+	{
+	#if _WIN32
+		return !isatty (0);
+	#else
+		struct stat st;
+		fstat (0, &st);
+		return S_ISFIFO (st.st_mode);
+	#endif
+	}
+
+	spsc_ring<char, 0x10000u> output;
+	spsc_ring<char, 0x1000u> input;
+
+	doorbell output_ready;
+	doorbell output_space;
+	doorbell input_ready;
+	doorbell input_space;
+
+	std::atomic<bool> input_done { false };
+	std::atomic<bool> stopping { false };
+	std::atomic<bool> closing { false };
+	bool stdin_piped { is_piped () };
+
+#if !defined(_WIN32)
+	int wake_pipe [2] { -1, -1 };
+#endif
+
+	/* last, they use everything above */
+	std::thread reader;
+	std::thread writer;
+};
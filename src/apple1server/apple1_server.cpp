@@ -0,0 +1,446 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+/*
+ * Apple-1 BASIC sessions for many users in one process, Linux only.
+ *
+ *   apple1_server [-w workers] [-q half cycles] socket
+ *
+ * Every connection to the Unix domain socket gets a machine of its own.
+ * One thread runs the sockets through epoll, a few workers run the
+ * machines. Each machine runs as a coroutine that runs a quantum of half
+ * cycles, its budget, then yields its worker to the next machine in
+ * line. When BASIC waits for a key that hasn't come in yet, it parks
+ * itself at the keyboard instead, and the front end schedules it again
+ * when its user types. Parked machines cost nothing but their memory.
+ *
+ * What a session buffers is capped both ways: a user who types faster
+ * than BASIC reads is no longer read from until BASIC catches up, and a
+ * machine whose output isn't taken off the socket parks until it is.
+ * A new machine is reset by its coroutine on a worker, not by the
+ * thread that accepts the connection.
+ *
+ * Connect with e.g. socat -,icanon=1,echo=1 UNIX-CONNECT:socket, the
+ * terminal echoes, BASIC's own echo is dropped.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <coroutine>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../apple1basic/apple1_machine.hpp"
+#include "../utils/scheduler.hpp"
+
+/* keys read from a connection and not yet typed, and output not yet sent, per session */
+static constexpr std::size_t inbound_limit = 0x1000u;
+static constexpr std::size_t outbound_limit = 0x10000u;
+
+struct session
+{
+	explicit session (int fd)
+	: fd { fd }
+	{}
+
+	const int fd;
+
+	/* between the front end and the coroutine, which alone has the machine */
+	std::mutex lock;
+	std::string inbound;
+	std::string outbound;
+	bool closed { false };
+
+	/* the coroutine while it is parked, and whether for output to go out rather than for keys */
+	std::coroutine_handle<> parked;
+	bool parked_on_output { false };
+
+	/* parks the coroutine until there are keys, or the user is gone */
+	auto keyboard ()
+	{
+		return awaiter { *this, false };
+	}
+
+	/* parks the coroutine until its output is below the limit again, or the user is gone */
+	auto display ()
+	{
+		return awaiter { *this, true };
+	}
+
+	/* the coroutine to schedule if it is parked and what it waits for is there, under the lock */
+	auto unpark () -> std::coroutine_handle<>
+	{
+		if (parked && runnable (parked_on_output))
+			return std::exchange (parked, nullptr);
+		return nullptr;
+	}
+
+private:
+	bool runnable (bool on_output) const
+	{
+		return closed || (on_output ? outbound.size () < outbound_limit : !inbound.empty ());
+	}
+
+	struct awaiter
+	{
+		session& s;
+		bool on_output;
+		bool await_ready () const noexcept { return false; }
+		bool await_suspend (std::coroutine_handle<> handle)
+		{
+			std::lock_guard guard { s.lock };
+			if (s.runnable (on_output))
+				return false;
+			s.parked = handle;
+			s.parked_on_output = on_output;
+			return true;
+		}
+		void await_resume () const noexcept {}
+	};
+};
+
+using session_ptr = std::shared_ptr<session>;
+
+struct server
+{
+	server (int listener, std::size_t workers, std::size_t quantum)
+	: listener	{ listener },
+		quantum		{ quantum },
+		machines	{ workers }
+	{}
+
+	/* whether epoll and the wakeup could be set up */
+	bool ready () const;
+
+	void run_front_end ();
+
+private:
+	void accept_all ();
+	void receive (const session_ptr& s);
+	void send (const session_ptr& s);
+	void close (const session_ptr& s);
+	bool watch (int fd, std::uint32_t events, int operation);
+	void watch (const session_ptr& s);
+	void wake (const session_ptr& s);
+	void unpark (const session_ptr& s);
+	auto run_machine (session_ptr s) -> scheduler_task;
+
+	const int listener;
+	const std::size_t quantum;
+	const int epoll { epoll_create1 (EPOLL_CLOEXEC) };
+	const int wakeup { eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC) };
+
+	/* the front end's own, no lock */
+	std::unordered_map<int, session_ptr> sessions;
+
+	/* sessions with output for the front end to send */
+	std::mutex flush_lock;
+	std::vector<session_ptr> to_flush;
+
+	/* last, so its workers are gone before what the machines use */
+	scheduler machines;
+};
+
+bool server::ready () const
+{
+	return epoll >= 0 && wakeup >= 0;
+}
+
+bool server::watch (int fd, std::uint32_t events, int operation)
+{
+	epoll_event event {};
+	event.events = events;
+	event.data.fd = fd;
+	return !epoll_ctl (epoll, operation, fd, &event);
+}
+
+/* reads while there is room for keys, asks for EPOLLOUT only while the socket holds output up, under the session lock */
+void server::watch (const session_ptr& s)
+{
+	watch (s->fd, (s->inbound.size () < inbound_limit ? EPOLLIN : 0u) | (s->outbound.empty () ? 0u : EPOLLOUT), EPOLL_CTL_MOD);
+}
+
+/* schedules the coroutine of a session if what it parked for is there, under the session lock */
+void server::unpark (const session_ptr& s)
+{
+	if (const auto parked = s->unpark ())
+		machines.schedule (parked);
+}
+
+/* has the front end send the output of a session and look at its buffers again */
+void server::wake (const session_ptr& s)
+{
+	{
+		std::lock_guard guard { flush_lock };
+		to_flush.push_back (s);
+	}
+	const std::uint64_t one = 1u;
+	[[maybe_unused]] const auto written = ::write (wakeup, &one, sizeof (one));
+}
+
+void server::run_front_end ()
+{
+	if (!watch (listener, EPOLLIN, EPOLL_CTL_ADD) || !watch (wakeup, EPOLLIN, EPOLL_CTL_ADD))
+	{
+		std::fprintf (stderr, "cannot watch the listener: %s\n", std::strerror (errno));
+		return;
+	}
+
+	epoll_event events [64];
+	for (;;)
+	{
+		const auto count = epoll_wait (epoll, events, 64, -1);
+		for (int i = 0; i < count; ++i)
+		{
+			const auto fd = events [i].data.fd;
+			if (fd == listener)
+			{
+				accept_all ();
+				continue;
+			}
+			if (fd == wakeup)
+			{
+				std::uint64_t value;
+				while (::read (wakeup, &value, sizeof (value)) > 0)
+					;
+				std::vector<session_ptr> flush;
+				{
+					std::lock_guard guard { flush_lock };
+					flush.swap (to_flush);
+				}
+				for (auto&& s : flush)
+					send (s);
+				continue;
+			}
+
+			auto found = sessions.find (fd);
+			if (found == sessions.end ())
+				continue;
+			const auto s = found->second;
+			if (events [i].events & (EPOLLHUP | EPOLLERR))
+			{
+				close (s);
+				continue;
+			}
+			if (events [i].events & EPOLLIN)
+				receive (s);
+			if (events [i].events & EPOLLOUT)
+				send (s);
+		}
+	}
+}
+
+void server::accept_all ()
+{
+	for (;;)
+	{
+		const auto fd = accept4 (listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+			return;
+		if (!watch (fd, EPOLLIN, EPOLL_CTL_ADD))
+		{
+			::close (fd);
+			continue;
+		}
+		auto s = std::make_shared<session> (fd);
+		sessions.emplace (fd, s);
+		machines.spawn (run_machine (std::move (s)));
+	}
+}
+
+void server::receive (const session_ptr& s)
+{
+	char buffer [4096];
+	for (;;)
+	{
+		std::size_t room;
+		{
+			std::lock_guard guard { s->lock };
+			room = inbound_limit - std::min (s->inbound.size (), inbound_limit);
+		}
+		if (!room)
+			break;
+
+		const auto count = ::read (s->fd, buffer, std::min (sizeof (buffer), room));
+		if (count == 0 || (count < 0 && errno != EAGAIN && errno != EINTR))
+		{
+			close (s);
+			return;
+		}
+		if (count < 0)
+			break;
+
+		std::lock_guard guard { s->lock };
+		for (ssize_t i = 0; i < count; ++i)
+			if (buffer [i] != '\r')
+				s->inbound.push_back (buffer [i]);
+		unpark (s);
+	}
+
+	std::lock_guard guard { s->lock };
+	watch (s);
+}
+
+void server::send (const session_ptr& s)
+{
+	std::lock_guard guard { s->lock };
+	if (s->closed)
+		return;
+	while (!s->outbound.empty ())
+	{
+		const auto count = ::send (s->fd, s->outbound.data (), s->outbound.size (), MSG_NOSIGNAL);
+		if (count < 0)
+		{
+			if (errno == EAGAIN)
+				break;
+			if (errno == EINTR)
+				continue;
+			s->outbound.clear ();
+			break;
+		}
+		s->outbound.erase (0u, std::size_t (count));
+	}
+	unpark (s);
+	watch (s);
+}
+
+void server::close (const session_ptr& s)
+{
+	{
+		std::lock_guard guard { s->lock };
+		s->closed = true;
+		/* the coroutine sees it is closed, returns and drops the session */
+		unpark (s);
+	}
+	epoll_ctl (epoll, EPOLL_CTL_DEL, s->fd, nullptr);
+	::close (s->fd);
+	sessions.erase (s->fd);
+}
+
+auto server::run_machine (session_ptr s) -> scheduler_task
+{
+	/* the reset runs here, on a worker */
+	apple1_machine machine;
+	std::string output;
+	for (;;)
+	{
+		auto resumed = false;
+		{
+			std::lock_guard guard { s->lock };
+			if (s->closed)
+				co_return;
+			/* one batch at a time, the rest waits in inbound and holds the socket up once that is full */
+			if (!machine.keys_waiting ())
+			{
+				resumed = s->inbound.size () >= inbound_limit;
+				machine.type (s->inbound);
+				s->inbound.clear ();
+			}
+		}
+
+		const auto status = machine.run (quantum);
+		machine.take_output (output);
+
+		auto stalled = false;
+		if (!output.empty ())
+		{
+			std::lock_guard guard { s->lock };
+			s->outbound.append (output);
+			stalled = s->outbound.size () >= outbound_limit;
+		}
+		if (!output.empty () || resumed)
+		{
+			wake (s);
+			output.clear ();
+		}
+
+		if (stalled)
+			co_await s->display ();
+		else if (status == apple1_machine::status::waiting_for_key)
+			co_await s->keyboard ();
+		else
+			co_await machines.yield ();
+	}
+}
+
+int main (int argc, char** argv)
+{
+	std::size_t workers = std::max (1u, std::thread::hardware_concurrency ());
+	std::size_t quantum = 20000u;
+	const char* path = nullptr;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!std::strcmp (argv [i], "-w") && i + 1 < argc)
+			workers = std::max (1ul, std::strtoul (argv [++i], nullptr, 10));
+		else if (!std::strcmp (argv [i], "-q") && i + 1 < argc)
+			quantum = std::max (1ul, std::strtoul (argv [++i], nullptr, 10));
+		else
+			path = argv [i];
+	}
+	if (!path)
+	{
+		std::fprintf (stderr, "usage: apple1_server [-w workers] [-q half cycles] socket\n");
+		return 1;
+	}
+
+	sockaddr_un address {};
+	address.sun_family = AF_UNIX;
+	if (std::strlen (path) >= sizeof (address.sun_path))
+	{
+		std::fprintf (stderr, "socket path too long: %s\n", path);
+		return 1;
+	}
+	std::strcpy (address.sun_path, path);
+
+	const auto listener = socket (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	unlink (path);
+	if (listener < 0 || bind (listener, reinterpret_cast<const sockaddr*> (&address), sizeof (address)) || listen (listener, 128))
+	{
+		std::fprintf (stderr, "cannot listen on %s: %s\n", path, std::strerror (errno));
+		return 1;
+	}
+	signal (SIGPIPE, SIG_IGN);
+
+	server apple1 { listener, workers, quantum };
+	if (!apple1.ready ())
+	{
+		std::fprintf (stderr, "cannot set up epoll: %s\n", std::strerror (errno));
+		return 1;
+	}
+	apple1.run_front_end ();
+}
@@ -0,0 +1,408 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+/*
+ * Runs the Apple-1 BASIC workload on every engine configuration and
+ * reports half-cycles per second. Keyboard input is read from stdin up
+ * front and handed to the guest whenever it polls for a key, so every
+ * configuration sees the same input at the same half-cycle. The bus
+ * trace hash tells whether the configurations agree, the exit code is
+ * non-zero when one of them differs from the first.
+ *
+ * With more than one instance every configuration runs that many
+ * machines side by side, one half-cycle each in turn, the way several
+ * emulated machines would share a core.
+ *
+ * -c reads the hardware counters of the core around the timed loop,
+ * where the kernel lets us (Linux perf events), and shows them per
+ * half-cycle and per node or group the engine decided. Without them
+ * the run goes on as usual.
+ *
+ *   benchmark [-c] [half-cycles] [instances] < test.txt
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../netlist_6502.hpp"
+#include "../apple1basic/apple1_basic_bin.hpp"
+
+struct benchmark_config
+{
+	const char* name;
+	netlist_6502_options options;
+};
+
+static const benchmark_config configs [] =
+{
+	{ "traversal",			{ } },
+	{ "incremental",		{ .groups = netlist_6502_groups::incremental } },
+	{ "derived",				{ .connectivity = netlist_6502_connectivity::derived } },
+	{ "byte_per_node",	{ .layout = netlist_6502_layout::byte_per_node } },
+	{ "pull_coded",			{ .layout = netlist_6502_layout::pull_coded } },
+	{ "dense_64",				{ .dense_threshold = 64u } },
+	{ "dense_always",		{ .dense_threshold = 1u } },
+	{ "jit",						{ .jit = true } },
+	{ "jit_derived",		{ .connectivity = netlist_6502_connectivity::derived, .jit = true } },
+	{ "pla_table",			{ .pla_table = true } },
+	{ "compact",				{ .tables = netlist_6502_tables::compact } },
+	{ "compact_derived",	{ .connectivity = netlist_6502_connectivity::derived, .tables = netlist_6502_tables::compact } },
+	{ "lazy",						{ .lazy = true } },
+};
+
+struct apple1_workload
+{
+	apple1_workload (const std::string& input)
+	: input { input }
+	{
+		std::memcpy (&memory [0xE000], apple1_basic_bin, sizeof (apple1_basic_bin));
+		memory [0xfffc] = 0x00;
+		memory [0xfffd] = 0xE0;
+	}
+
+	void step (netlist_6502& nlsym)
+	{
+		auto clk = nlsym.clock ();
+		nlsym.clock (!clk);
+		nlsym.eval ();
+		if (!clk)
+			handle_bus (nlsym);
+	}
+
+	void handle_bus (netlist_6502& nlsym)
+	{
+		auto a = nlsym.address ();
+		if (nlsym.read ())
+		{
+			nlsym.data (memory [a]);
+			if ((a & 0xFF1F) == 0xD010)
+			{
+				int c = input_pos < input.size () ? input [input_pos++] : 0;
+				if (c == 10)
+					c = 13;
+				nlsym.data (std::uint8_t (c | 0x80));
+			}
+			if ((a & 0xFF1F) == 0xD011)
+				nlsym.data (nlsym.pc () == 0xE006 && input_pos < input.size () ? 0x80 : 0);
+			if ((a & 0xFF1F) == 0xD012)
+				nlsym.data (0);
+		}
+		else
+		{
+			auto d = nlsym.data ();
+			memory [a] = d;
+			if ((a & 0xFF1F) == 0xD012)
+				mix (d);
+		}
+		mix (a);
+		mix (nlsym.data ());
+	}
+
+	void mix (std::uint64_t value)
+	{
+		hash = (hash ^ value) * 1099511628211ull;
+	}
+
+	std::uint8_t memory [0x10000] {};
+	const std::string& input;
+	std::size_t input_pos { 0u };
+	std::uint64_t hash { 1469598103934665603ull };
+};
+
+/*
+ * Hardware counters of this thread, opened as one group so they are all
+ * scheduled on the core together and ratios between them hold. A counter
+ * the core or the kernel doesn't offer is left out of the group, the
+ * first one that opens leads it. When the core has fewer counters than
+ * the group needs the kernel multiplexes it, the counts then cover only
+ * part of the run and are scaled up by the time the group was enabled
+ * over the time it actually ran.
+ */
+struct perf_counters
+{
+	static constexpr std::size_t count = 5u;
+	static constexpr const char* names [count] = { "cycles", "instructions", "L1D misses", "LLC misses", "branch misses" };
+
+	perf_counters ()
+	{
+#if defined(__linux__)
+		constexpr auto cache = [] (std::uint64_t cache, std::uint64_t op, std::uint64_t result) {
+			return cache | op << 8u | result << 16u;
+		};
+		const std::pair<std::uint32_t, std::uint64_t> events [count] =
+		{
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HW_CACHE, cache (PERF_COUNT_HW_CACHE_L1D, PERF_COUNT_HW_CACHE_OP_READ, PERF_COUNT_HW_CACHE_RESULT_MISS) },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+		};
+		for (std::size_t i = 0u; i < count; ++i)
+		{
+			perf_event_attr attr {};
+			attr.size = sizeof (attr);
+			attr.type = events [i].first;
+			attr.config = events [i].second;
+			attr.disabled = leader < 0 ? 1 : 0;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			fds [i] = int (syscall (SYS_perf_event_open, &attr, 0, -1, leader, 0));
+			if (fds [i] < 0)
+			{
+				if (!error)
+					error = errno;
+				continue;
+			}
+			if (leader < 0)
+				leader = fds [i];
+			slots [i] = members++;
+		}
+#endif
+	}
+
+	~perf_counters ()
+	{
+#if defined(__linux__)
+		for (auto fd : fds)
+			if (fd >= 0)
+				close (fd);
+#endif
+	}
+
+	perf_counters (const perf_counters&) = delete;
+	perf_counters& operator = (const perf_counters&) = delete;
+
+	bool any () const
+	{
+		return leader >= 0;
+	}
+
+	/* why a counter is missing, for the one line that says so */
+	auto reason () const -> const char*
+	{
+#if defined(__linux__)
+		return error ? std::strerror (error) : "not supported";
+#else
+		return "no perf events on this system";
+#endif
+	}
+
+	void start ()
+	{
+#if defined(__linux__)
+		ioctl (leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl (leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+
+	/* stops the group and reads all of it at once */
+	void stop ()
+	{
+#if defined(__linux__)
+		ioctl (leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+		/* number of members, time enabled, time running, then one value per member */
+		std::uint64_t buffer [3u + count] {};
+		const auto expected = ssize_t ((3u + members) * sizeof (std::uint64_t));
+		if (::read (leader, buffer, sizeof (buffer)) != expected || buffer [0] != members)
+		{
+			enabled = running = 0u;
+			return;
+		}
+		enabled = buffer [1];
+		running = buffer [2];
+		for (std::size_t i = 0u; i < count; ++i)
+			if (slots [i] < count)
+				raw [i] = buffer [3u + slots [i]];
+#endif
+	}
+
+	/* true when the group only ran for part of the time it was enabled */
+	bool multiplexed () const
+	{
+		return running < enabled;
+	}
+
+	/* the count over the last start () to stop (), scaled, negative when it isn't known */
+	auto value (std::size_t index) const -> double
+	{
+		if (slots [index] >= count || !running)
+			return -1.0;
+		return double (raw [index]) * double (enabled) / double (running);
+	}
+
+	/* the share of the time enabled the group was on the core */
+	auto coverage () const -> double
+	{
+		return enabled ? double (running) / double (enabled) : 0.0;
+	}
+
+	int fds [count] { -1, -1, -1, -1, -1 };
+	int leader { -1 };
+	int error { 0 };
+
+	/* position of each counter in the group's read, count when it isn't in the group */
+	std::size_t slots [count] { count, count, count, count, count };
+	std::size_t members { 0u };
+
+	std::uint64_t raw [count] {};
+	std::uint64_t enabled { 0u };
+	std::uint64_t running { 0u };
+};
+
+static void
+print_counters (const perf_counters& counters, double half_cycles, double groups)
+{
+	for (const auto& [label, divisor] : { std::pair { "  per half-cycle", half_cycles }, std::pair { "  per group", groups } })
+	{
+		std::printf ("%-16s", label);
+		for (std::size_t i = 0u; i < perf_counters::count; ++i)
+		{
+			const auto value = counters.value (i);
+			if (value < 0.0)
+				std::printf (" %14s %-13s", "-", perf_counters::names [i]);
+			else
+				std::printf (" %14.1f %-13s", value / divisor, perf_counters::names [i]);
+		}
+		std::printf ("\n");
+	}
+	if (counters.multiplexed ())
+		std::printf ("  counters were multiplexed, on the core %.1f %% of the run, counts scaled up\n", 100.0 * counters.coverage ());
+}
+
+/* the trace of the first configuration is the reference for the others */
+static auto
+run (const benchmark_config& config, const std::string& input, long half_cycles, std::size_t instances, 
+	const std::uint64_t* reference, perf_counters* counters) -> std::uint64_t
+{
+	std::vector<std::unique_ptr<apple1_workload>> workloads;
+	std::vector<std::unique_ptr<netlist_6502>> machines;
+	for (std::size_t i = 0u; i < instances; ++i)
+	{
+		workloads.push_back (std::make_unique<apple1_workload> (input));
+		machines.push_back (std::make_unique<netlist_6502> (config.options));
+	}
+
+	/* hold RESET for 8 cycles, then release it */
+	for (std::size_t m = 0u; m < instances; ++m)
+	{
+		for (int i = 0; i < 16; i++)
+			workloads [m]->step (*machines [m]);
+		machines [m]->reset (1);
+	}
+
+	std::uint64_t groups { 0u };
+	for (auto&& machine : machines)
+		groups -= machine->counters ().groups;
+
+	/* the bus handling in the loop is tiny next to eval () */
+	if (counters)
+		counters->start ();
+	const auto start = std::chrono::steady_clock::now ();
+	for (long i = 0; i < half_cycles; ++i)
+		for (std::size_t m = 0u; m < instances; ++m)
+			workloads [m]->step (*machines [m]);
+	const auto stop = std::chrono::steady_clock::now ();
+	if (counters)
+		counters->stop ();
+
+	for (auto&& machine : machines)
+		groups += machine->counters ().groups;
+
+	/* every instance ran the same input, any difference is a bug */
+	bool agree { true };
+	for (auto&& workload : workloads)
+		agree &= workload->hash == workloads.front ()->hash;
+
+	const auto hash = workloads.front ()->hash;
+	const auto seconds = std::chrono::duration<double> (stop - start).count ();
+	std::printf ("%-16s %10.3f s %12.0f half-cycles/s   trace %016llx%s%s\n", 
+		config.name, seconds, double (half_cycles) * double (instances) / seconds, (unsigned long long)hash, 
+		agree ? "" : "   instances disagree",
+		!reference || *reference == hash ? "" : "   trace differs");
+	if (counters)
+		print_counters (*counters, double (half_cycles) * double (instances), double (std::max<std::uint64_t> (groups, 1u)));
+	return agree ? hash : 0u;
+}
+
+int main (int argc, char** argv)
+{
+	bool use_counters { false };
+	const char* arguments [2] { nullptr, nullptr };
+	for (int i = 1, positional = 0; i < argc; ++i)
+	{
+		if (!std::strcmp (argv [i], "-c"))
+			use_counters = true;
+		else if (positional < 2)
+			arguments [positional++] = argv [i];
+	}
+	const long half_cycles = arguments [0] ? std::atol (arguments [0]) : 100000;
+	const auto instances = std::size_t (arguments [1] ? std::max (1, std::atoi (arguments [1])) : 1);
+
+	std::string input;
+	for (int c; (c = std::getchar ()) != EOF; )
+		input.push_back (char (c));
+
+	std::printf ("tables: fused %zu bytes, compact %zu bytes, %zu instance(s)\n",
+		netlist_6502::table_bytes (netlist_6502_tables::fused), 
+		netlist_6502::table_bytes (netlist_6502_tables::compact), instances);
+
+	std::unique_ptr<perf_counters> counters;
+	if (use_counters)
+	{
+		counters = std::make_unique<perf_counters> ();
+		if (!counters->any ())
+		{
+			std::printf ("hardware counters unavailable: %s\n", counters->reason ());
+			counters.reset ();
+		}
+	}
+
+	int result { EXIT_SUCCESS };
+	std::uint64_t reference { 0u };
+	for (auto&& config : configs)
+	{
+		const auto hash = run (config, input, half_cycles, instances, &config == configs ? nullptr : &reference, counters.get ());
+		if (&config == configs)
+			reference = hash;
+		else if (hash != reference)
+			result = EXIT_FAILURE;
+	}
+	return result;
+}
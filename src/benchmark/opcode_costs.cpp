@@ -0,0 +1,179 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+/*
+ * What every opcode costs the switch-level engine. For each of the 256
+ * opcodes and each operand variant a fresh netlist_6502 runs a few
+ * instructions that set up the registers and flags, then the opcode
+ * with its two operand bytes. All other memory holds NOPs, and the
+ * vectors point into them, so jumps, returns and interrupts land
+ * somewhere harmless.
+ *
+ * The instruction is measured from its opcode fetch to the next one,
+ * in half-cycles, waves, groups decided and nodes flipped. The time is
+ * the fastest of the repeats. Opcodes that jam the processor never get
+ * to the next fetch and are marked as such.
+ *
+ *   opcode_costs [repeats] > costs.txt
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../netlist_6502.hpp"
+#include "../netlist_6502_opcodes.hpp"
+
+/* register and flag setup before the opcode, and its operand bytes */
+struct opcode_variant
+{
+	const char* name;
+	std::uint8_t setup [16];
+	std::size_t setup_size;
+	std::uint8_t operands [2];
+};
+
+static const opcode_variant variants [] =
+{
+	/* X = Y = 0, A = 0, flags Z, operands point low and branch forward */
+	{ "low",	{ 0xA2, 0x00, 0xA0, 0x00, 0x18, 0xB8, 0xA9, 0x00 }, 8u, { 0x10, 0x00 } },
+	/* X = Y = $FF, A = $80, flags N V C, indexing crosses a page and branches go back */
+	{ "high",	{ 0xA2, 0xFF, 0xA0, 0xFF, 0x38, 0x24, 0xFE, 0xA9, 0x80 }, 9u, { 0x80, 0x12 } },
+};
+
+/* the cost of one instruction, jammed when there was no next fetch */
+struct opcode_cost
+{
+	bool jammed { false };
+	std::uint64_t half_cycles { 0u };
+	netlist_6502_counters work {};
+	double seconds { 0.0 };
+};
+
+struct opcode_program
+{
+	static constexpr std::uint16_t origin = 0x0200u;
+
+	opcode_program (std::uint8_t opcode, const opcode_variant& variant)
+	: opcode_address { std::uint16_t (origin + variant.setup_size) }
+	{
+		std::memset (memory, 0xEA, sizeof (memory));
+		std::memcpy (&memory [origin], variant.setup, variant.setup_size);
+		memory [opcode_address] = opcode;
+		memory [opcode_address + 1u] = variant.operands [0];
+		memory [opcode_address + 2u] = variant.operands [1];
+		memory [0xfffc] = origin & 0xffu;
+		memory [0xfffd] = origin >> 8u;
+	}
+
+	/* one half-cycle, true on an opcode fetch */
+	bool step (netlist_6502& nlsym)
+	{
+		auto clk = nlsym.clock ();
+		nlsym.clock (!clk);
+		nlsym.eval ();
+		if (clk)
+			return false;
+
+		auto a = nlsym.address ();
+		if (!nlsym.read ())
+		{
+			memory [a] = nlsym.data ();
+			return false;
+		}
+		nlsym.data (memory [a]);
+		return nlsym.sync ();
+	}
+
+	auto run () -> opcode_cost
+	{
+		netlist_6502 nlsym;
+		for (int i = 0; i < 16; i++)
+			step (nlsym);
+		nlsym.reset (1);
+
+		/* reset takes a few cycles, setup at most two per byte */
+		opcode_cost cost;
+		std::uint64_t half_cycles { 0u };
+		while (!(step (nlsym) && nlsym.address () == opcode_address))
+			if (++half_cycles > 200u)
+				return { .jammed = true };
+
+		/* the longest instructions take 8 cycles, the jams never end */
+		const auto start = std::chrono::steady_clock::now ();
+		const auto before = nlsym.counters ();
+		for (;;)
+		{
+			++cost.half_cycles;
+			if (step (nlsym))
+				break;
+			if (cost.half_cycles > 64u)
+				return { .jammed = true };
+		}
+		const auto stop = std::chrono::steady_clock::now ();
+		const auto after = nlsym.counters ();
+
+		cost.work = {
+			after.waves - before.waves,
+			after.groups - before.groups,
+			after.nodes_flipped - before.nodes_flipped
+		};
+		cost.seconds = std::chrono::duration<double> (stop - start).count ();
+		return cost;
+	}
+
+	std::uint8_t memory [0x10000];
+	std::uint16_t opcode_address;
+};
+
+int main (int argc, char** argv)
+{
+	const auto repeats = argc > 1 ? std::max (1, std::atoi (argv [1])) : 3;
+
+	std::printf ("%-4s %-12s %-6s %11s %7s %8s %8s %10s\n", 
+		"op", "instruction", "setup", "half-cycles", "waves", "groups", "flipped", "us");
+	for (unsigned opcode = 0u; opcode < 256u; ++opcode)
+	{
+		for (auto&& variant : variants)
+		{
+			opcode_program program { std::uint8_t (opcode), variant };
+			auto cost = program.run ();
+			for (int r = 1; r < repeats && !cost.jammed; ++r)
+			{
+				opcode_program again { std::uint8_t (opcode), variant };
+				cost.seconds = std::min (cost.seconds, again.run ().seconds);
+			}
+
+			if (cost.jammed)
+			{
+				std::printf ("%02x   %-12s %-6s %11s\n", opcode, netlist_6502_opcode_names [opcode], variant.name, "jammed");
+				continue;
+			}
+			std::printf ("%02x   %-12s %-6s %11llu %7llu %8llu %8llu %10.1f\n", opcode, netlist_6502_opcode_names [opcode], variant.name, 
+				(unsigned long long)cost.half_cycles, (unsigned long long)cost.work.waves, 
+				(unsigned long long)cost.work.groups, (unsigned long long)cost.work.nodes_flipped, cost.seconds * 1e6);
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,480 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+/*
+ * Times the utils containers with the access patterns the engine puts on
+ * them. The patterns come from a trace of the Apple-1 BASIC workload:
+ * for every half-cycle the nodes that changed, the bus, and the groups
+ * of the nodes behind the transistors the changed nodes switch. The
+ * groups are searched by the engine's own group_add_node on the node
+ * values and conducting transistors the half-cycle settled at, with the
+ * pulls the chip powers up with.
+ *
+ * Every kernel runs over the whole trace a number of times and reports
+ * nanoseconds per operation. group_add_node and the adjacency ranges
+ * are timed as the engine calls them, array_set::clear on its own, the
+ * rest on the nodes of the groups. Kernels that do the same work in
+ * another way (get_bits against a get per bit, the sorted insert against
+ * the linear one, the ranges against a pointer loop) print the same
+ * checksum.
+ *
+ * The group search and its state are internal to netlist_6502.cpp, so
+ * this target builds it into this translation unit instead of linking it.
+ *
+ *   utils_benchmark [half-cycles] [repeats] < test.txt
+ */
+
+#include "../netlist_6502.cpp"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "../apple1basic/apple1_machine.hpp"
+
+using node_bitmap = bitmap<netlist_6502_node_count>;
+using transistor_bitmap = bitmap<netlist_6502_transistor_count>;
+using group_state = basic_state_type<nodes_bit_packed<netlist_6502_node_count>, node_adjacency>;
+
+struct utils_trace
+{
+	/* node values before the first half-cycle and after every one */
+	node_bitmap initial;
+	std::vector<node_bitmap> values;
+
+	/* conducting transistors after every half-cycle */
+	std::vector<transistor_bitmap> conducting;
+
+	/* nodes that changed in a half-cycle, from changes_index [h] */
+	std::vector<std::uint16_t> changes;
+	std::vector<std::size_t> changes_index;
+
+	/* address and data bus after every half-cycle */
+	std::vector<std::uint16_t> address;
+	std::vector<std::uint8_t> data;
+
+	/* every group search: the node it starts at, its half-cycle and its nodes from members_index [w] */
+	std::vector<std::uint16_t> seeds;
+	std::vector<std::size_t> walk_half_cycle;
+	std::vector<std::uint16_t> members;
+	std::vector<std::size_t> members_index;
+
+	auto walk_count () const { return seeds.size (); }
+	auto half_cycle_count () const { return values.size (); }
+};
+
+/* the two nodes every transistor joins, from the per node bridge lists */
+static auto
+transistor_ends () -> std::vector<std::pair<std::uint16_t, std::uint16_t>>
+{
+	std::vector<std::pair<std::uint16_t, std::uint16_t>> ends (netlist_6502_transistor_count);
+	for (std::size_t node = 0u; node < netlist_6502_node_count; ++node)
+	{
+		for (auto i = node_bridge_index [node]; i < node_bridge_index [node + 1]; ++i)
+			ends [node_bridge [i].first] = { std::uint16_t (node), node_bridge [i].second };
+	}
+	return ends;
+}
+
+/* a group search state with the node values the trace starts with */
+static auto
+make_group_state (const utils_trace& trace) -> std::unique_ptr<group_state>
+{
+	auto state = std::make_unique<group_state> ();
+	initialize_state (*state, {});
+	for (std::size_t node = 0u; node < netlist_6502_node_count; ++node)
+		state->nodes.try_set_value (node, trace.initial.get (node));
+	return state;
+}
+
+/* takes the state to the node values and conducting transistors half-cycle h settled at */
+static void
+load_half_cycle (group_state& state, const utils_trace& trace, std::size_t h)
+{
+	for (auto i = trace.changes_index [h]; i < trace.changes_index [h + 1]; ++i)
+		state.nodes.try_set_value (trace.changes [i], trace.values [h].get (trace.changes [i]));
+	state.is_connected = trace.conducting [h];
+}
+
+static void
+search_group (group_state& state, std::uint16_t seed)
+{
+	state.group.clear ();
+	state.group_contains_value = contains_nothing;
+	group_add_node (state, seed);
+}
+
+static auto
+capture (const std::string& input, std::size_t half_cycles) -> utils_trace
+{
+	utils_trace trace;
+	apple1_machine machine { { .local_echo = false, .piped_input = true } };
+	machine.type (input);
+
+	const auto ends = transistor_ends ();
+	machine.cpu ().copy_nodes (trace.initial.data ());
+	auto state = make_group_state (trace);
+	node_bitmap previous { trace.initial };
+
+	trace.changes_index.push_back (0u);
+	trace.members_index.push_back (0u);
+	for (std::size_t h = 0u; h < half_cycles; ++h)
+	{
+		if (machine.run (1u) == apple1_machine::status::waiting_for_key)
+			break;
+
+		auto&& cpu = machine.cpu ();
+		node_bitmap current;
+		transistor_bitmap conducting;
+		cpu.copy_nodes (current.data ());
+		cpu.copy_transistors (conducting.data ());
+
+		for (std::size_t node = 0u; node < netlist_6502_node_count; ++node)
+		{
+			if (current.get (node) != previous.get (node))
+				trace.changes.push_back (std::uint16_t (node));
+		}
+		trace.changes_index.push_back (trace.changes.size ());
+		trace.values.push_back (current);
+		trace.conducting.push_back (conducting);
+		trace.address.push_back (cpu.address ());
+		trace.data.push_back (cpu.data ());
+		load_half_cycle (*state, trace, h);
+
+		/* the groups on either side of the transistors the changed nodes switch, each once */
+		node_bitmap seeded;
+		for (auto c = trace.changes_index [h]; c < trace.changes_index [h + 1]; ++c)
+		{
+			const auto node = trace.changes [c];
+			for (auto i = gate_to_transistor_index [node]; i < gate_to_transistor_index [node + 1]; ++i)
+			{
+				const auto [lhs, rhs] = ends [gate_to_transistor [i]];
+				for (const auto seed : { lhs, rhs })
+				{
+					if (seeded.get (seed) || seed == node_names::vcc || seed == node_names::vss)
+						continue;
+					search_group (*state, seed);
+					for (auto member : state->group)
+					{
+						seeded.set (member, true);
+						trace.members.push_back (member);
+					}
+					trace.seeds.push_back (seed);
+					trace.walk_half_cycle.push_back (h);
+					trace.members_index.push_back (trace.members.size ());
+				}
+			}
+		}
+		previous = current;
+	}
+	return trace;
+}
+
+static void
+report (const char* name, double seconds, std::size_t operations, std::size_t repeats, std::uint64_t checksum)
+{
+	std::printf ("%-34s %8.2f ns/op %12zu ops   checksum %016llx\n", name, 
+		seconds * 1e9 / double (operations * repeats), operations, (unsigned long long)checksum);
+}
+
+template <typename _Kernel>
+static void
+measure (const char* name, std::size_t repeats, std::size_t operations, _Kernel&& kernel)
+{
+	std::uint64_t checksum { 0u };
+	const auto start = std::chrono::steady_clock::now ();
+	for (std::size_t r = 0u; r < repeats; ++r)
+		checksum += kernel ();
+	const auto stop = std::chrono::steady_clock::now ();
+	report (name, std::chrono::duration<double> (stop - start).count (), operations, repeats, checksum);
+}
+
+template <auto... _Index>
+static auto
+get_each (const node_bitmap& values) -> std::uint64_t
+{
+	std::uint64_t value { 0u };
+	std::size_t bit { 0u };
+	((value |= std::uint64_t (values.get (_Index)) << bit++), ...);
+	return value;
+}
+
+template <auto... _Index>
+static void
+set_each (node_bitmap& values, std::uint64_t value)
+{
+	std::size_t bit { 0u };
+	(values.set (_Index, (value >> bit++) & 1u), ...);
+}
+
+#define UTILS_ADDRESS_NODES \
+	node_names::ab0, node_names::ab1, node_names::ab2, node_names::ab3, \
+	node_names::ab4, node_names::ab5, node_names::ab6, node_names::ab7, \
+	node_names::ab8, node_names::ab9, node_names::ab10, node_names::ab11, \
+	node_names::ab12, node_names::ab13, node_names::ab14, node_names::ab15
+
+#define UTILS_DATA_NODES \
+	node_names::db0, node_names::db1, node_names::db2, node_names::db3, \
+	node_names::db4, node_names::db5, node_names::db6, node_names::db7
+
+/* array_sets filled ahead of every timed batch of clears */
+static constexpr std::size_t clear_batch = 32u;
+
+int main (int argc, char** argv)
+{
+	const auto half_cycles = std::size_t (argc > 1 ? std::max (1l, std::atol (argv [1])) : 20000l);
+	const auto repeats = std::size_t (argc > 2 ? std::max (1, std::atoi (argv [2])) : 20);
+
+	std::string input;
+	for (int c; (c = std::getchar ()) != EOF; )
+		input.push_back (char (c));
+
+	const auto trace = capture (input, half_cycles);
+	const auto hc = trace.half_cycle_count ();
+	const auto walks = trace.walk_count ();
+	const auto& members = trace.members;
+	const auto& members_index = trace.members_index;
+	std::printf ("trace: %zu half-cycles, %zu changed nodes, %zu group searches, %zu group nodes\n",
+		hc, trace.changes.size (), walks, members.size ());
+
+	measure ("group_add_node", repeats, walks, [&]
+	{
+		static auto state = make_group_state (trace);
+		std::uint64_t sum { 0u };
+		std::size_t loaded { 0u };
+		for (std::size_t w = 0u; w < walks; ++w)
+		{
+			for (; loaded <= trace.walk_half_cycle [w]; ++loaded)
+				load_half_cycle (*state, trace, loaded);
+			search_group (*state, trace.seeds [w]);
+			sum += state->group.size () * 8u + std::uint64_t (state->group_contains_value);
+		}
+		/* back to the start for the next repeat */
+		for (std::size_t node = 0u; node < netlist_6502_node_count; ++node)
+			state->nodes.try_set_value (node, trace.initial.get (node));
+		return sum;
+	});
+
+	measure ("bitmap::get", repeats, members.size (), [&]
+	{
+		std::uint64_t sum { 0u };
+		for (std::size_t w = 0u; w < walks; ++w)
+		{
+			auto&& values = trace.values [trace.walk_half_cycle [w]];
+			for (auto i = members_index [w]; i < members_index [w + 1]; ++i)
+				sum += values.get (members [i]);
+		}
+		return sum;
+	});
+
+	measure ("bitmap::set", repeats, trace.changes.size (), [&]
+	{
+		node_bitmap values { trace.initial };
+		for (std::size_t h = 0u; h < hc; ++h)
+			for (auto i = trace.changes_index [h]; i < trace.changes_index [h + 1]; ++i)
+				values.set (trace.changes [i], trace.values [h].get (trace.changes [i]));
+		std::uint64_t sum { 0u };
+		for (std::size_t word = 0u; word < node_bitmap::num_words; ++word)
+			sum += values.word (word);
+		return sum;
+	});
+
+	measure ("bitmap::try_set", repeats, members.size (), [&]
+	{
+		node_bitmap values { trace.initial };
+		std::uint64_t changed { 0u };
+		for (std::size_t w = 0u; w < walks; ++w)
+		{
+			auto&& next = trace.values [trace.walk_half_cycle [w]];
+			for (auto i = members_index [w]; i < members_index [w + 1]; ++i)
+				changed += values.try_set (members [i], next.get (members [i]));
+		}
+		return changed;
+	});
+
+	measure ("bitmap::get_bits address+data", repeats, hc, [&]
+	{
+		std::uint64_t sum { 0u };
+		for (auto&& values : trace.values)
+			sum += values.get_bits<std::uint16_t, UTILS_ADDRESS_NODES> () * 256u + values.get_bits<std::uint8_t, UTILS_DATA_NODES> ();
+		return sum;
+	});
+
+	measure ("bitmap::get per bit address+data", repeats, hc, [&]
+	{
+		std::uint64_t sum { 0u };
+		for (auto&& values : trace.values)
+			sum += get_each<UTILS_ADDRESS_NODES> (values) * 256u + get_each<UTILS_DATA_NODES> (values);
+		return sum;
+	});
+
+	measure ("bitmap::set_bits address+data", repeats, hc, [&]
+	{
+		node_bitmap values;
+		std::uint64_t sum { 0u };
+		for (std::size_t h = 0u; h < hc; ++h)
+		{
+			values.set_bits<UTILS_ADDRESS_NODES> (trace.address [h]);
+			values.set_bits<UTILS_DATA_NODES> (trace.data [h]);
+			sum += values.word (1);
+		}
+		return sum;
+	});
+
+	measure ("bitmap::set per bit address+data", repeats, hc, [&]
+	{
+		node_bitmap values;
+		std::uint64_t sum { 0u };
+		for (std::size_t h = 0u; h < hc; ++h)
+		{
+			set_each<UTILS_ADDRESS_NODES> (values, trace.address [h]);
+			set_each<UTILS_DATA_NODES> (values, trace.data [h]);
+			sum += values.word (1);
+		}
+		return sum;
+	});
+
+	measure ("array_set::insert_unique", repeats, members.size (), [&]
+	{
+		static array_set<std::uint16_t, netlist_6502_node_count> group;
+		std::uint64_t sum { 0u };
+		for (std::size_t w = 0u; w < walks; ++w)
+		{
+			group.clear ();
+			for (auto i = members_index [w]; i < members_index [w + 1]; ++i)
+				sum += group.insert_unique (members [i]);
+		}
+		return sum;
+	});
+
+	/* only the clears are timed, the clock is read once per batch */
+	{
+		static array_set<std::uint16_t, netlist_6502_node_count> groups [clear_batch];
+		std::chrono::steady_clock::duration elapsed {};
+		std::uint64_t cleared { 0u };
+		for (std::size_t r = 0u; r < repeats; ++r)
+		{
+			for (std::size_t w = 0u; w < walks; w += clear_batch)
+			{
+				const auto batch = std::min (clear_batch, walks - w);
+				for (std::size_t b = 0u; b < batch; ++b)
+				{
+					for (auto i = members_index [w + b]; i < members_index [w + b + 1]; ++i)
+						groups [b].insert_unique (members [i]);
+					cleared += groups [b].size ();
+				}
+				const auto start = std::chrono::steady_clock::now ();
+				for (std::size_t b = 0u; b < batch; ++b)
+					groups [b].clear ();
+				elapsed += std::chrono::steady_clock::now () - start;
+			}
+		}
+		report ("array_set::clear", std::chrono::duration<double> (elapsed).count (), walks, repeats, cleared);
+	}
+
+	measure ("array_list::insert_unique", repeats, members.size (), [&]
+	{
+		static array_list<std::uint16_t, netlist_6502_node_count> group;
+		std::uint64_t sum { 0u };
+		for (std::size_t w = 0u; w < walks; ++w)
+		{
+			group.clear ();
+			for (auto i = members_index [w]; i < members_index [w + 1]; ++i)
+				group.insert_unique (members [i]);
+			sum += group.size ();
+		}
+		return sum;
+	});
+
+	measure ("array_list::insert_unique_linear", repeats, members.size (), [&]
+	{
+		static array_list<std::uint16_t, netlist_6502_node_count> group;
+		std::uint64_t sum { 0u };
+		for (std::size_t w = 0u; w < walks; ++w)
+		{
+			group.clear ();
+			for (auto i = members_index [w]; i < members_index [w + 1]; ++i)
+				group.insert_unique_linear (members [i]);
+			sum += group.size ();
+		}
+		return sum;
+	});
+
+	std::size_t bridges { 0u };
+	std::size_t component_nodes { 0u };
+	for (auto node : members)
+	{
+		const auto component = netlist_6502_components.node_component [node];
+		bridges += std::size_t (node_bridge_index [node + 1] - node_bridge_index [node]);
+		component_nodes += std::size_t (netlist_6502_components.component_nodes_index [component + 1] - 
+			netlist_6502_components.component_nodes_index [component]);
+	}
+
+	measure ("strided_range bridges", repeats, bridges, [&]
+	{
+		std::uint64_t sum { 0u };
+		for (auto node : members)
+			for (auto&& [tindex, gindex, nindex] : node_adjacency (node).bridges ())
+				sum += tindex ^ gindex ^ nindex;
+		return sum;
+	});
+
+	measure ("pointer loop bridges", repeats, bridges, [&]
+	{
+		std::uint64_t sum { 0u };
+		for (auto node : members)
+		{
+			const auto* record = &netlist_6502_adjacency.data [netlist_6502_adjacency.index [node]];
+			const auto* bridge = record + adjacency_header + record [adjacency_gates] * 2u;
+			for (const auto* last = bridge + record [adjacency_bridges] * 3u; bridge != last; bridge += 3)
+				sum += bridge [0] ^ bridge [1] ^ bridge [2];
+		}
+		return sum;
+	});
+
+	measure ("indexed_range component nodes", repeats, component_nodes, [&]
+	{
+		auto&& components = netlist_6502_components;
+		std::uint64_t sum { 0u };
+		for (auto node : members)
+			for (auto member : make_indexed_range (components.component_nodes, components.component_nodes_index, components.node_component [node]))
+				sum += member;
+		return sum;
+	});
+
+	measure ("pointer loop component nodes", repeats, component_nodes, [&]
+	{
+		auto&& components = netlist_6502_components;
+		std::uint64_t sum { 0u };
+		for (auto node : members)
+		{
+			const auto component = components.node_component [node];
+			const auto* last = &components.component_nodes [0] + components.component_nodes_index [component + 1];
+			for (const auto* member = &components.component_nodes [0] + components.component_nodes_index [component]; member != last; ++member)
+				sum += *member;
+		}
+		return sum;
+	});
+
+	return EXIT_SUCCESS;
+}
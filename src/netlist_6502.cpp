@@ -20,12 +20,15 @@
  THE SOFTWARE.
 */
 
+#include <algorithm>
+#include <array>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iterator>
 #include <initializer_list>
 #include <stdexcept>
+#include <variant>
 #include <vector>
 
 #include "utils/bitmap.hpp"
@@ -33,11 +36,18 @@
 #include "utils/array_set.hpp"
 #include "utils/range.hpp"
 #include "utils/misc.hpp"
+#include "utils/seqlock.hpp"
 
 #include "types.hpp"
 #include "netlist_6502.hpp"
 #include "netlist_6502_labels.hpp"
 #include "netlist_6502_transdefs.inl"
+#include "netlist_6502_components.hpp"
+#include "netlist_6502_adjacency.hpp"
+#include "netlist_6502_compact.hpp"
+#include "netlist_6502_layout.hpp"
+#include "netlist_6502_pla.hpp"
+#include "netlist_6502_jit.hpp"
 
 template <typename _Array, typename _Index, typename _Begin>
 auto make_indexed_range(_Array&& array, _Index&& index, _Begin&& begin)
@@ -45,19 +55,81 @@ auto make_indexed_range(_Array&& array, _Index&& index, _Begin&& begin)
 	return indexed_range(array, index[begin], index[begin+1]);
 }
 
-struct state_type
+template <typename _Nodes, typename _Adjacency>
+struct basic_state_type
 {
-	bitmap<netlist_6502_node_count>	nodes_pullu;
-	bitmap<netlist_6502_node_count>	nodes_pulld;
-	bitmap<netlist_6502_node_count>	nodes_value;
+	using adjacency_type = _Adjacency;
+
+	netlist_6502_options options;
+
+	_Nodes nodes;
 	bitmap<netlist_6502_transistor_count>	is_connected;
 	array_set<std::uint16_t, netlist_6502_node_count> group;
-	array_set<std::uint16_t, netlist_6502_node_count> outputs;
 	group_contains_value_t group_contains_value;
+
+	/* wave frontier in insertion order, nodes of the current wave and nodes for the next one */
+	array_set<std::uint16_t, netlist_6502_node_count> frontier [2];
+	array_set<std::uint16_t, netlist_6502_node_count>* inputs		{ &frontier [0] };
+	array_set<std::uint16_t, netlist_6502_node_count>* outputs	{ &frontier [1] };
+
+	/* nodes whose group has already been solved in the current wave */
+	bitmap<netlist_6502_node_count> solved;
+
+	/* waves run so far towards the current fixed point */
+	int waves;
+
+	/* a lazy eval() whose waves haven't all run yet */
+	bool deferred;
+
+	/* conducting transistors per component, and per node to vss and vcc */
+	std::uint16_t live_bridges [netlist_6502_component_slots];
+
+	/*
+	 * incremental groups, a union-find forest over the nodes of each
+	 * component with every group also kept as a circular list
+	 */
+	bitmap<netlist_6502_node_count + 1> component_dirty;
+	nodenum_t group_parent [netlist_6502_node_count];
+	nodenum_t group_next [netlist_6502_node_count];
+
+	/* nodes with a conducting transistor to vss and to vcc, kept for dense waves */
+	bitmap<netlist_6502_node_count> supply_vss;
+	bitmap<netlist_6502_node_count> supply_vcc;
+
+	/* single nodes of a word that flip, valid while the word's bit in decided is set */
+	std::uint64_t flips [bitmap<netlist_6502_node_count>::num_words];
+	bitmap<bitmap<netlist_6502_node_count>::num_words> decided;
+
+	/* values of the decode PLA inputs, one bit each, and the rows queued next to either frontier */
+	std::uint32_t pla_inputs;
+	netlist_6502_pla_wave pla_waves [2];
+
+	netlist_6502_counters counters;
+
+	/* native node updates and group searches, shared by all instances, null when interpreted */
+	const netlist_6502_jit* jit { nullptr };
+	netlist_6502_jit_context jit_context {};
+};
+
+/* every node layout with every table encoding, in the order of the enums */
+struct state_type
+{
+	/* mutable, in lazy mode the const getters run the waves eval() left pending */
+	mutable std::variant<
+		basic_state_type<nodes_bit_packed<netlist_6502_node_count>, node_adjacency>,
+		basic_state_type<nodes_byte_packed<netlist_6502_node_count>, node_adjacency>,
+		basic_state_type<nodes_pull_coded<netlist_6502_node_count>, node_adjacency>,
+		basic_state_type<nodes_bit_packed<netlist_6502_node_count>, node_adjacency_compact>,
+		basic_state_type<nodes_byte_packed<netlist_6502_node_count>, node_adjacency_compact>,
+		basic_state_type<nodes_pull_coded<netlist_6502_node_count>, node_adjacency_compact>> engine;
+
+	std::uint64_t generation { 0u };
+	seqlock<netlist_6502_snapshot> snapshots;
 };
 
+template <typename _State>
 static inline void
-group_add_node (state_type& state, nodenum_t nindex)
+group_add_node (_State& state, nodenum_t nindex)
 {
 	/*
 	 * We need to stop at vss and vcc, otherwise we'll revisit other groups
@@ -82,14 +154,25 @@ group_add_node (state_type& state, nodenum_t nindex)
 
 	switch (state.group_contains_value)
 	{
-	case contains_nothing:	if (state.nodes_pulld.get (nindex)) inplace_max (state.group_contains_value, contains_pulldown);
-	case contains_hi:				if (state.nodes_pullu.get (nindex)) inplace_max (state.group_contains_value, contains_pullup);
-	case contains_pullup:		if (state.nodes_value.get (nindex)) inplace_max (state.group_contains_value, contains_hi);
+	case contains_nothing:	if (state.nodes.pulldown (nindex)) inplace_max (state.group_contains_value, contains_pulldown);
+	case contains_hi:				if (state.nodes.pullup (nindex)) inplace_max (state.group_contains_value, contains_pullup);
+	case contains_pullup:		if (state.nodes.value (nindex)) inplace_max (state.group_contains_value, contains_hi);
 	default:
 		break;
 	}
 	/* revisit all transistors that control this node */	
-	for (auto&& [tindex, nindex0] : make_indexed_range(node_bridge, node_bridge_index, nindex))
+	if (state.options.connectivity == netlist_6502_connectivity::derived)
+	{
+		for (auto&& [tindex, gindex, nindex0] : typename _State::adjacency_type (nindex).bridges ())
+		{
+			/* the transistor connects c1 and c2 when its gate is high */
+			if (state.nodes.value (gindex))
+				group_add_node (state, nindex0);
+		}
+		return;
+	}
+
+	for (auto&& [tindex, gindex, nindex0] : typename _State::adjacency_type (nindex).bridges ())
 	{		 
 		/* if the transistor connects c1 and c2... */
 		if (state.is_connected.get (tindex))
@@ -97,17 +180,289 @@ group_add_node (state_type& state, nodenum_t nindex)
 	}
 }
 
+template <typename _State>
+static inline bool
+bridge_is_connected (const _State& state, transnum_t tindex, nodenum_t gindex)
+{
+	if (state.options.connectivity == netlist_6502_connectivity::derived)
+		return state.nodes.value (gindex);
+	return state.is_connected.get (tindex);
+}
+
+template <typename _State>
+static inline bool
+group_is_single_node (const _State& state, nodenum_t node)
+{
+	const auto component = netlist_6502_components.node_component [node];
+	return !state.live_bridges [component * bridge_kinds + bridge_internal];
+}
+
+template <typename _State>
 static inline void
-group_add_all_nodes (state_type& state, nodenum_t node)
+group_add_single_node (_State& state, nodenum_t node)
+{
+	/*
+	 * nothing joins this node to another one, only its own
+	 * transistors to vss and vcc can decide the value
+	 */
+	state.group.insert_unique (node);
+
+	if (state.live_bridges [node * bridge_kinds + bridge_to_vss])
+		state.group_contains_value = contains_vss;
+	else if (state.live_bridges [node * bridge_kinds + bridge_to_vcc])
+		state.group_contains_value = contains_vcc;
+	else if (state.nodes.pulldown (node))
+		state.group_contains_value = contains_pulldown;
+	else if (state.nodes.pullup (node))
+		state.group_contains_value = contains_pullup;
+	else if (state.nodes.value (node))
+		state.group_contains_value = contains_hi;
+}
+
+template <typename _State>
+static inline auto
+group_find (_State& state, nodenum_t nindex) -> nodenum_t
+{
+	auto&& parent = state.group_parent;
+	while (parent [nindex] != nindex)
+		nindex = parent [nindex] = parent [parent [nindex]];
+	return nindex;
+}
+
+template <typename _State>
+static inline void
+group_join (_State& state, nodenum_t lhs, nodenum_t rhs)
+{
+	lhs = group_find (state, lhs);
+	rhs = group_find (state, rhs);
+	if (lhs == rhs)
+		return;
+	state.group_parent [std::max (lhs, rhs)] = std::min (lhs, rhs);
+	/* splicing two circular lists merges them */
+	std::swap (state.group_next [lhs], state.group_next [rhs]);
+}
+
+template <typename _State>
+static inline void
+group_rebuild_component (_State& state, nodenum_t component)
+{
+	auto&& components = netlist_6502_components;
+	const auto members = make_indexed_range (components.component_nodes, components.component_nodes_index, component);
+
+	for (auto&& nindex : members)
+	{
+		state.group_parent [nindex] = nindex;
+		state.group_next [nindex] = nindex;
+	}
+
+	for (auto&& nindex : members)
+	{
+		for (auto&& [tindex, gindex, nindex0] : typename _State::adjacency_type (nindex).bridges ())
+		{
+			if (!one_of<node_names::vcc, node_names::vss> (nindex0) && bridge_is_connected (state, tindex, gindex))
+				group_join (state, nindex, nindex0);
+		}
+	}
+
+	state.component_dirty.set (component, false);
+}
+
+template <typename _State>
+static inline void
+group_add_partition (_State& state, nodenum_t node)
+{
+	const auto component = netlist_6502_components.node_component [node];
+	if (state.component_dirty.get (component))
+		group_rebuild_component (state, component);
+
+	const auto first = group_find (state, node);
+	auto nindex = first;
+	do
+	{
+		state.group.insert_unique (nindex);
+		switch (state.group_contains_value)
+		{
+		case contains_nothing:	if (state.nodes.pulldown (nindex)) inplace_max (state.group_contains_value, contains_pulldown);
+			[[fallthrough]];
+		case contains_hi:				if (state.nodes.pullup (nindex)) inplace_max (state.group_contains_value, contains_pullup);
+			[[fallthrough]];
+		case contains_pullup:		if (state.nodes.value (nindex)) inplace_max (state.group_contains_value, contains_hi);
+			break;
+		default:
+			break;
+		}
+		if (state.live_bridges [nindex * bridge_kinds + bridge_to_vss])
+			state.group_contains_value = contains_vss;
+		else if (state.live_bridges [nindex * bridge_kinds + bridge_to_vcc] && state.group_contains_value != contains_vss)
+			state.group_contains_value = contains_vcc;
+		nindex = state.group_next [nindex];
+	}
+	while (nindex != first);
+}
+
+template <typename _State>
+static inline void
+group_transistor_toggled (_State& state, transnum_t tindex, std::uint16_t slot, bool value)
+{
+	if (slot % bridge_kinds != bridge_internal)
+		return;
+
+	/* a new connection can be merged in place, a lost one splits the group */
+	const auto component = nodenum_t (slot / bridge_kinds);
+	if (value && !state.component_dirty.get (component))
+	{
+		const auto [lhs, rhs] = netlist_6502_components.transistor_nodes [tindex];
+		group_join (state, lhs, rhs);
+	}
+	else
+		state.component_dirty.set (component, true);
+}
+
+/*
+ * The generated search collects the group in the order of group_add_node
+ * and notes the supplies it ran into. A supply outranks anything a member
+ * brings, otherwise the members are folded in the order they joined, as
+ * group_add_node does while walking.
+ */
+template <typename _State>
+static inline void
+group_add_compiled (_State& state, nodenum_t node)
+{
+	state.jit->group_search (node) (&state.jit_context);
+
+	if (state.jit_context.group_supplies & jit_reached_vss)
+	{
+		state.group_contains_value = contains_vss;
+		return;
+	}
+
+	if (state.jit_context.group_supplies & jit_reached_vcc)
+	{
+		state.group_contains_value = contains_vcc;
+		return;
+	}
+
+	for (auto&& nindex : state.group)
+	{
+		switch (state.group_contains_value)
+		{
+		case contains_nothing:	if (state.nodes.pulldown (nindex)) inplace_max (state.group_contains_value, contains_pulldown);
+			[[fallthrough]];
+		case contains_hi:				if (state.nodes.pullup (nindex)) inplace_max (state.group_contains_value, contains_pullup);
+			[[fallthrough]];
+		case contains_pullup:		if (state.nodes.value (nindex)) inplace_max (state.group_contains_value, contains_hi);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+template <typename _State>
+static inline void
+group_add_all_nodes (_State& state, nodenum_t node)
 {	
 	state.group.clear ();
 	state.group_contains_value = contains_nothing;	
-	group_add_node (state, node);
+	if (group_is_single_node (state, node))
+		group_add_single_node (state, node);
+	else if (state.jit && state.jit->group_search (node))
+		group_add_compiled (state, node);
+	else if (state.options.groups == netlist_6502_groups::incremental)
+		group_add_partition (state, node);
+	else
+		group_add_node (state, node);
+}
+
+template <typename _State>
+static inline void
+node_set_value (_State& state, nodenum_t nindex, bool new_value)
+{
+	if (!state.nodes.try_set_value (nindex, new_value))
+		return;
+	++state.counters.nodes_flipped;
+
+	if (state.options.pla_table)
+	{
+		const auto bit = netlist_6502_pla.input_bit [nindex];
+		if (bit != netlist_6502_pla_type::no_input)
+			state.pla_inputs ^= std::uint32_t (1u) << bit;
+	}
+
+	if (state.jit)
+	{
+		state.jit->node_changed (nindex, new_value) (&state.jit_context);
+		return;
+	}
+
+	if (state.options.dense_threshold)
+		state.decided.set (nindex / bitmap<netlist_6502_node_count>::word_size, false);
+
+	const typename _State::adjacency_type adjacency { nindex };
+
+	for (auto&& [transistor, slot] : adjacency.gates ())
+	{
+		/* the rows never look at their transistors */
+		if (state.options.pla_table && netlist_6502_pla.transistors.get (transistor))
+			continue;
+		if (state.options.connectivity == netlist_6502_connectivity::stored)
+			state.is_connected.set (transistor, new_value);
+		auto&& live = state.live_bridges [slot];
+		live = new_value ? live + 1u : live - 1u;
+		if (state.options.groups == netlist_6502_groups::incremental)
+			group_transistor_toggled (state, transistor, slot, new_value);
+		if (state.options.dense_threshold)
+		{
+			if (slot % bridge_kinds == bridge_to_vss)
+				state.supply_vss.set (slot / bridge_kinds, live != 0u);
+			else if (slot % bridge_kinds == bridge_to_vcc)
+				state.supply_vcc.set (slot / bridge_kinds, live != 0u);
+			else
+				continue;
+			state.decided.set (slot / bridge_kinds / bitmap<netlist_6502_node_count>::word_size, false);
+		}
+	}
+
+	for (auto&& nindex : adjacency.depends (new_value))
+	{
+		/* the rows are decoded from their inputs, they never join a wave */
+		if (state.options.pla_table && netlist_6502_pla.rows.get (nindex))
+		{
+			auto&& wave = state.pla_waves [state.outputs - state.frontier];
+			if (wave.queued.try_set (nindex, true))
+				wave.rows.push ({ std::uint16_t (state.outputs->size ()), nindex });
+			continue;
+		}
+		state.outputs->insert_unique (nindex);
+	}
 }
 
+/*
+ * Decodes the queued rows of the decode PLA that the wave reaches before
+ * frontier position `position`, each a single test of the packed inputs
+ * against its mask. They are decoded exactly where the interpreter would
+ * have solved them, so the rest of the wave sees the same values.
+ */
+template <typename _State>
 static inline void
-recalculate_node (state_type& state, nodenum_t node)
+pla_decode_rows (_State& state, std::size_t& next, std::size_t position)
 {
+	auto&& rows = state.pla_waves [state.inputs - state.frontier].rows;
+	for (; next < rows.size () && rows [next].first <= position; ++next)
+	{
+		/* a decode row is high while none of its inputs is */
+		const auto row = rows [next].second;
+		++state.counters.groups;
+		node_set_value (state, row, !(state.pla_inputs & netlist_6502_pla.row_inputs [row]));
+	}
+}
+
+template <typename _State>
+static inline void
+recalculate_node (_State& state, nodenum_t node)
+{
+	++state.counters.groups;
+
 	/*
 	 * get all nodes that are connected through
 	 * transistors, starting with this one
@@ -128,32 +483,87 @@ recalculate_node (state_type& state, nodenum_t node)
 	 */
 
 	for (auto&& nindex : state.group)
-	{
-		if (!state.nodes_value.try_set(nindex, new_value))
-			continue;
+		node_set_value (state, nindex, new_value);
 
-		for (auto&& transistor : make_indexed_range (gate_to_transistor, gate_to_transistor_index, nindex))
-			state.is_connected.set (transistor, new_value);
+	/*
+	 * every member would rebuild the very same group, anything
+	 * that changes it later in this wave queues it for the next one
+	 */
+	for (auto&& nindex : state.group)
+		state.solved.set (nindex, true);
+}
 
-		auto&& node_deps_index	= new_value ? node_depends_lhs_index	: node_depends_rhs_index;
-		auto&& node_deps				= new_value ? node_depends_lhs				: node_depends_rhs;
+/*
+ * One wave over the frontier with the single node groups decided a word
+ * of 64 nodes at a time, with the same priorities as group_add_single_node,
+ * vss over vcc over the pull-down over the pull-up over the value the node
+ * had. The frontier is still walked in insertion order: the decisions of a
+ * word are kept until one of its nodes flips or gains or loses a transistor
+ * to a supply, so every node still sees what the nodes before it did.
+ */
+template <typename _State>
+static inline void
+recalculate_frontier_words (_State& state)
+{
+	constexpr auto word_size = bitmap<netlist_6502_node_count>::word_size;
 
-		for (auto&& nindex : make_indexed_range(node_deps, node_deps_index, nindex))
-			state.outputs.insert_unique (nindex);
+	state.decided.clear ();
+	std::size_t row { 0u };
+	for (std::size_t position = 0u; position < state.inputs->size (); ++position)
+	{
+		const auto nindex = (*state.inputs) [position];
+		if (state.options.pla_table)
+			pla_decode_rows (state, row, position);
+
+		if (!netlist_6502_single_nodes.get (nindex))
+		{
+			if (!state.solved.get (nindex))
+				recalculate_node (state, nindex);
+			continue;
+		}
+
+		++state.counters.groups;
+		const auto word = nindex / word_size;
+		if (!state.decided.get (word))
+		{
+			const auto value = state.nodes.value_word (word);
+			const auto new_value = ~state.supply_vss.word (word) & 
+				(state.supply_vcc.word (word) | (~state.nodes.pulldown_word (word) & 
+					(state.nodes.pullup_word (word) | value)));
+
+			state.flips [word] = (new_value ^ value) & netlist_6502_single_nodes.word (word);
+			state.decided.set (word, true);
+		}
+
+		if ((state.flips [word] >> (nindex % word_size)) & 1u)
+			node_set_value (state, nindex, !state.nodes.value (nindex));
 	}
+	if (state.options.pla_table)
+		pla_decode_rows (state, row, state.inputs->size ());
 }
 
+/*
+ * Runs waves until nothing changes, or with a cone given, until nothing
+ * pending can change a node of the cone any more. The remaining waves
+ * are left in the frontier and picked up by the next call.
+ */
+template <typename _State>
 static inline void
-recalculate_node_list (state_type& state)
+recalculate_node_list (_State& state, const bitmap<netlist_6502_node_count>* cone = nullptr)
 {
 	/* loop limiter */
-	static int max = 0;
-	for (auto j : range (0, 100))
+	for (; state.waves < 100; ++state.waves)
 	{		
-		if (state.outputs.empty ())
+		if (state.outputs->empty () && state.pla_waves [state.outputs - state.frontier].rows.empty ())
 			break;
-		auto inputs = state.outputs.as_array();
-		state.outputs.clear ();
+		if (cone && !state.outputs->as_bitmap ().intersects (*cone) && 
+			!state.pla_waves [state.outputs - state.frontier].queued.intersects (*cone))
+			return;
+		std::swap (state.inputs, state.outputs);
+		state.jit_context.output_marks = state.outputs->marks_data ();
+		state.jit_context.output_items = state.outputs->items_data ();
+		state.jit_context.output_size = state.outputs->size_data ();
+		++state.counters.waves;
 
 		/*
 		 * for all nodes, follow their paths through
@@ -162,10 +572,77 @@ recalculate_node_list (state_type& state)
 		 * all transistors controlled by this path, collecting
 		 * all nodes that changed because of it for the next run
 		 */
-		for (auto&& nindex : inputs)
-			recalculate_node (state, nindex);
+		if (state.options.dense_threshold && state.inputs->size () >= state.options.dense_threshold)
+			recalculate_frontier_words (state);
+		else if (state.options.pla_table)
+		{
+			std::size_t row { 0u };
+			for (std::size_t position = 0u; position < state.inputs->size (); ++position)
+			{
+				pla_decode_rows (state, row, position);
+				const auto nindex = (*state.inputs) [position];
+				if (!state.solved.get (nindex))
+					recalculate_node (state, nindex);
+			}
+			pla_decode_rows (state, row, state.inputs->size ());
+		}
+		else
+		{
+			for (auto&& nindex : *state.inputs)
+			{
+				if (!state.solved.get (nindex))
+					recalculate_node (state, nindex);
+			}
+		}
+		state.inputs->clear ();
+		state.pla_waves [state.inputs - state.frontier].clear ();
+		state.solved.clear ();
 	}
-	state.outputs.clear ();
+	state.outputs->clear ();
+	state.waves = 0;
+	state.deferred = false;
+}
+
+/*
+ * Every node whose recalculation can end up changing one of the given
+ * nodes: the members of their components, which share their groups,
+ * and whatever queues one of those when it flips, transitively.
+ */
+static auto
+make_cone (std::initializer_list<nodenum_t> nodes) -> bitmap<netlist_6502_node_count>
+{
+	bitmap<netlist_6502_node_count> cone;
+	for (auto nindex : nodes)
+		cone.set (nindex, true);
+
+	for (bool grown = true; grown; )
+	{
+		grown = false;
+		for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+		{
+			if (cone.get (nindex))
+				continue;
+
+			bool reaches { false };
+			const auto component = netlist_6502_components.node_component [nindex];
+			if (component != netlist_6502_supply_component)
+			{
+				for (auto k = netlist_6502_components.component_nodes_index [component]; k < netlist_6502_components.component_nodes_index [component + 1]; ++k)
+					reaches |= cone.get (netlist_6502_components.component_nodes [k]);
+			}
+			const node_adjacency adjacency { nindex };
+			for (const bool value : { false, true })
+				for (auto&& dependent : adjacency.depends (value))
+					reaches |= cone.get (dependent);
+
+			if (reaches)
+			{
+				cone.set (nindex, true);
+				grown = true;
+			}
+		}
+	}
+	return cone;
 }
 
 template <auto... _Index, typename _New_value>
@@ -179,10 +656,14 @@ write_nodes (state_type& state, _New_value value)
 	else
 		not_value = !value;
 
-	state.nodes_pullu.set_bits<_Index...>(value);
-	state.nodes_pulld.set_bits<_Index...>(not_value);
-	for (const auto index : { _Index ... })
-		state.outputs.insert_unique (index);
+	std::visit ([&] (auto& state) {
+		/* a lazy write still lands after the eval() before it */
+		if (state.deferred)
+			recalculate_node_list (state);
+		state.nodes.template set_pulls<_Index...>(value, not_value);
+		for (const auto index : { _Index ... })
+			state.outputs->insert_unique (index);
+	}, state.engine);
 }
 
 template <auto... _Index, typename _New_value>
@@ -190,7 +671,14 @@ requires (sizeof...(_Index) <= sizeof(_New_value) * 8)
 static inline void
 read_nodes (const state_type& state, _New_value& value)
 {
-	value = state.nodes_value.get_bits<_New_value, _Index...>();
+	std::visit ([&value] (auto& state) {
+		if (state.deferred)
+		{
+			static const auto cone = make_cone ({ _Index... });
+			recalculate_node_list (state, &cone);
+		}
+		value = state.nodes.template get_values<_New_value, _Index...>();
+	}, state.engine);
 }
 
 template <typename _New_value, auto... _Index>
@@ -204,16 +692,100 @@ read_nodes (const state_type& state) -> _New_value
 
 
 netlist_6502::netlist_6502 ()
-: state{ std::make_unique<state_type> () }
+: netlist_6502 (netlist_6502_options {})
+{ }
+
+template <typename _State>
+static inline void
+initialize_state (_State& state, const netlist_6502_options& options)
 {
-	auto& state = *this->state;
+	state.options = options;
 
-	state.nodes_pullu = netlist_6502_initial_state;
-	state.nodes_pulld.clear ();
-	state.nodes_value.clear ();
+	state.nodes.reset (netlist_6502_initial_state);
 	state.is_connected.clear ();
 	state.group.clear ();
-	state.outputs.clear ();
+	state.inputs->clear ();
+	state.outputs->clear ();
+	state.solved.clear ();
+	state.waves = 0;
+	state.deferred = false;
+	state.supply_vss.clear ();
+	state.supply_vcc.clear ();
+
+	std::fill (std::begin (state.live_bridges), std::end (state.live_bridges), 0u);
+	/* keeps vcc and vss off the single node path, they don't form a group */
+	state.live_bridges [netlist_6502_supply_component * bridge_kinds + bridge_internal] = 1u;
+
+	state.pla_inputs = 0u;
+	state.pla_waves [0].clear ();
+	state.pla_waves [1].clear ();
+	state.counters = {};
+
+	state.jit = nullptr;
+	if constexpr (requires { state.nodes.value_bits (); } && std::is_same_v<typename _State::adjacency_type, node_adjacency>)
+	{
+		const bool store_connectivity = options.connectivity == netlist_6502_connectivity::stored;
+		if (options.jit && options.groups == netlist_6502_groups::traversal && !options.dense_threshold && !options.pla_table)
+			state.jit = netlist_6502_jit::shared (store_connectivity);
+		state.jit_context = { 
+			state.live_bridges, 
+			store_connectivity ? state.is_connected.data () : nullptr,
+			state.outputs->marks_data (),
+			state.outputs->items_data (),
+			state.outputs->size_data (),
+			state.group.marks_data (),
+			store_connectivity ? state.is_connected.data () : state.nodes.value_bits (),
+			state.group.items_data (),
+			state.group.size_data (),
+			0u
+		};
+	}
+
+	/* every component gets its groups on first use */
+	for (auto index : range (0, netlist_6502_node_count + 1))
+		state.component_dirty.set (index, true);
+}
+
+/*
+ * The chip settles at power-up with the decode PLA at transistor level,
+ * so every row is worked out once the way the netlist has it. The packed
+ * inputs are taken over from the node values afterwards.
+ */
+template <typename _State>
+static inline void
+settle_power_up (_State& state)
+{
+	const auto pla_table = std::exchange (state.options.pla_table, false);
+	recalculate_node_list (state);
+	state.options.pla_table = pla_table;
+
+	state.pla_inputs = 0u;
+	for (std::size_t bit = 0u; bit < netlist_6502_pla.input_count; ++bit)
+	{
+		if (state.nodes.value (netlist_6502_pla.inputs [bit]))
+			state.pla_inputs |= std::uint32_t (1u) << bit;
+	}
+}
+
+template <std::size_t _Index = 0u, typename _Engine>
+static inline void
+emplace_engine (_Engine& engine, std::size_t index)
+{
+	if constexpr (_Index < std::variant_size_v<_Engine>)
+	{
+		if (index == _Index)
+			engine.template emplace<_Index> ();
+		else
+			emplace_engine<_Index + 1u> (engine, index);
+	}
+}
+
+netlist_6502::netlist_6502 (const netlist_6502_options& options)
+: state{ std::make_unique<state_type> () }
+{
+	auto&& engine = this->state->engine;
+	emplace_engine (engine, std::size_t (options.layout) + std::size_t (options.tables) * 3u);
+	std::visit ([&options] (auto& state) { initialize_state (state, options); }, engine);
 
 	reset	(0);
 	clock	(1);
@@ -222,10 +794,11 @@ netlist_6502::netlist_6502 ()
 	nmi	(1);
 	so (1);
 
-	for (auto index : range (0, netlist_6502_node_count))
-		state.outputs.insert_unique (index);
-
-	eval();
+	std::visit ([] (auto& state) {
+		for (auto index : range (0, netlist_6502_node_count))
+			state.outputs->insert_unique (index);
+		settle_power_up (state);
+	}, engine);
 }
 
 netlist_6502::~netlist_6502 ()
@@ -234,7 +807,103 @@ netlist_6502::~netlist_6502 ()
 
 void netlist_6502::eval ()
 {
-	recalculate_node_list (*state);
+	const auto interval = std::visit ([] (auto& state) { 
+		if (state.options.lazy)
+			state.deferred = true;
+		else
+			recalculate_node_list (state); 
+		return state.options.publish_interval;
+	}, state->engine);
+
+	++state->generation;
+	if (interval && state->generation % interval == 0u)
+		state->snapshots.publish (snapshot ());
+}
+
+void netlist_6502::settle ()
+{
+	std::visit ([] (auto& state) { recalculate_node_list (state); }, state->engine);
+}
+
+auto netlist_6502::snapshot () const -> netlist_6502_snapshot
+{
+	return netlist_6502_snapshot {
+		.generation = state->generation,
+		.address	= address (),
+		.pc				= pc (),
+		.data			= data (),
+		.a				= a (),
+		.x				= x (),
+		.y				= y (),
+		.s				= s (),
+		.p				= p (),
+		.ir				= ir (),
+		.clock		= clock (),
+		.read			= read (),
+		.sync			= sync (),
+		.reset		= reset (),
+		.ready		= ready (),
+		.irq			= irq (),
+		.nmi			= nmi ()
+	};
+}
+
+auto netlist_6502::published () const -> netlist_6502_snapshot
+{
+	return state->snapshots.read ();
+}
+
+auto netlist_6502::table_bytes (netlist_6502_tables tables) -> std::size_t
+{
+	if (tables == netlist_6502_tables::compact)
+		return sizeof (netlist_6502_compact);
+	return sizeof (netlist_6502_adjacency);
+}
+
+auto netlist_6502::node_count () -> std::size_t
+{
+	return netlist_6502_node_count;
+}
+
+auto netlist_6502::transistor_count () -> std::size_t
+{
+	return netlist_6502_transistor_count;
+}
+
+void netlist_6502::copy_nodes (std::uint64_t* words) const
+{
+	std::visit ([words] (auto& state) {
+		if (state.deferred)
+			recalculate_node_list (state);
+		for (std::size_t i = 0u; i < (netlist_6502_node_count + 63u) / 64u; ++i)
+			words [i] = state.nodes.value_word (i);
+	}, state->engine);
+
+	/* the supplies never go through the engine, their stored values mean nothing */
+	using namespace node_names;
+	words [vcc / 64u] |= std::uint64_t (1u) << (vcc % 64u);
+	words [vss / 64u] &= ~(std::uint64_t (1u) << (vss % 64u));
+}
+
+auto netlist_6502::counters () const -> netlist_6502_counters
+{
+	return std::visit ([] (auto& state) { return state.counters; }, state->engine);
+}
+
+void netlist_6502::copy_transistors (std::uint64_t* words) const
+{
+	bitmap<netlist_6502_node_count> values;
+	copy_nodes (values.data ());
+
+	/* a transistor conducts when its gate is high, whatever the connectivity option */
+	std::fill_n (words, (netlist_6502_transistor_count + 63u) / 64u, std::uint64_t (0u));
+	for (std::size_t i = 0u; i < netlist_6502_node_count; ++i)
+	{
+		if (!values.get (i))
+			continue;
+		for (auto&& [transistor, slot] : node_adjacency (i).gates ())
+			words [transistor / 64u] |= std::uint64_t (1u) << (transistor % 64u);
+	}
 }
 
 auto netlist_6502::address () const -> std::uint16_t
@@ -19,13 +19,110 @@
  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  THE SOFTWARE.
 */
+#pragma once
 
 #include <memory>
 #include <span>
 
+enum class netlist_6502_groups
+{
+	traversal,		/* search every group through the conducting transistors */
+	incremental		/* keep the groups of every component, redo them when transistors toggle */
+};
+
+enum class netlist_6502_connectivity
+{
+	stored,				/* keep a bitmap of conducting transistors */
+	derived				/* read the gate node of a transistor when it matters */
+};
+
+enum class netlist_6502_layout
+{
+	bit_packed,			/* separate bitmaps for pull-up, pull-down and value */
+	byte_per_node,	/* all flags of a node in one byte */
+	pull_coded			/* pulls as two bit codes, the value as a bitmap */
+};
+
+enum class netlist_6502_tables
+{
+	fused,				/* one record of uint16 entries per node */
+	compact				/* the same records delta and varint coded, decoded on the fly */
+};
+
+struct netlist_6502_options
+{
+	netlist_6502_groups groups { netlist_6502_groups::traversal };
+	netlist_6502_connectivity connectivity { netlist_6502_connectivity::stored };
+	netlist_6502_layout layout { netlist_6502_layout::bit_packed };
+	netlist_6502_tables tables { netlist_6502_tables::fused };
+
+	/*
+	 * waves with at least this many nodes decide their single node
+	 * groups a word of nodes at a time instead of node by node, 0 never does
+	 */
+	std::size_t dense_threshold { 0u };
+
+	/*
+	 * run node updates and group searches as native code, generated once
+	 * and shared by all instances, only on x86-64 with the bit packed
+	 * layout, fused tables, traversal groups, no dense waves and no PLA
+	 * table, the interpreter takes over anywhere else
+	 */
+	bool jit { false };
+
+	/*
+	 * decode PLA rows from their packed inputs instead of their transistors,
+	 * the rows are kept out of the frontier
+	 */
+	bool pla_table { false };
+
+	/*
+	 * eval() leaves its waves pending, a getter only runs them until
+	 * nothing pending can change the nodes it reads, the next pin write
+	 * or settle() runs the rest. The const getters, snapshot() and
+	 * copy_nodes() then change the engine, they are not thread-safe
+	 * even against each other, published() still is.
+	 */
+	bool lazy { false };
+
+	/* publish a snapshot for other threads every this many eval() calls, 0 never */
+	std::size_t publish_interval { 0u };
+};
+
+/* registers and pins as seen after one eval() */
+struct netlist_6502_snapshot
+{
+	std::uint64_t generation;		/* eval() calls so far */
+	std::uint16_t address;
+	std::uint16_t pc;
+	std::uint8_t data;
+	std::uint8_t a;
+	std::uint8_t x;
+	std::uint8_t y;
+	std::uint8_t s;
+	std::uint8_t p;
+	std::uint8_t ir;
+	bool clock;
+	bool read;
+	bool sync;
+	bool reset;
+	bool ready;
+	bool irq;
+	bool nmi;
+};
+
+/* work done by eval() so far, counted whatever the options */
+struct netlist_6502_counters
+{
+	std::uint64_t waves;					/* waves run over the frontier */
+	std::uint64_t groups;					/* nodes and groups of nodes decided */
+	std::uint64_t nodes_flipped;	/* node values that changed */
+};
+
 struct netlist_6502
 {
 	netlist_6502();
+	explicit netlist_6502(const netlist_6502_options& options);
  ~netlist_6502();
 	
 	netlist_6502 (const netlist_6502&) = delete;
@@ -35,6 +132,32 @@ struct netlist_6502
 
 	void eval();
 
+	/* run all pending waves, also in lazy mode */
+	void settle();
+
+	/* registers and pins right now, on the thread that runs the simulation */
+	auto snapshot () const -> netlist_6502_snapshot;
+
+	/*
+	 * the latest published snapshot, safe to call from any thread while
+	 * the simulation runs, it never holds up the simulating thread
+	 */
+	auto published () const -> netlist_6502_snapshot;
+
+	/* size of the adjacency tables, one copy shared by all instances */
+	static auto table_bytes (netlist_6502_tables tables) -> std::size_t;
+
+	static auto node_count				() -> std::size_t;
+	static auto transistor_count	() -> std::size_t;
+
+	/* node values, one bit per node in (node_count () + 63) / 64 words */
+	void copy_nodes (std::uint64_t* words) const;
+
+	/* conducting transistors, one bit per transistor in (transistor_count () + 63) / 64 words */
+	void copy_transistors (std::uint64_t* words) const;
+
+	auto counters () const -> netlist_6502_counters;
+
 	auto address	() const -> std::uint16_t;
 	auto data			() const -> std::uint8_t;
 	auto clock		() const -> bool;
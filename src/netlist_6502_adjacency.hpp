@@ -0,0 +1,132 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+/*
+ * The separate CSR tables fused into one record per node, so processing
+ * a node reads one contiguous block instead of five scattered arrays.
+ * A record is
+ *
+ *   gate count, bridge count, lhs count, rhs count
+ *   gates		(transistor, counter slot) for every transistor the node switches
+ *   bridges	(transistor, gate, node) for every transistor between the node and another one
+ *   lhs			nodes to revisit when the node goes high
+ *   rhs			nodes to revisit when the node goes low
+ *
+ * Bridges carry their gate node inline, a transistor conducts exactly
+ * when its gate is high.
+ */
+
+enum node_adjacency_field
+{
+	adjacency_gates,
+	adjacency_bridges,
+	adjacency_depends_lhs,
+	adjacency_depends_rhs,
+	adjacency_header
+};
+
+static inline constexpr auto netlist_6502_adjacency_size = 
+	netlist_6502_node_count * adjacency_header +
+	std::size (gate_to_transistor) * 2u + 
+	std::size (node_bridge) * 3u +
+	std::size (node_depends_lhs) + 
+	std::size (node_depends_rhs);
+
+struct netlist_6502_adjacency_type
+{
+	std::uint16_t index [netlist_6502_node_count];
+	std::uint16_t data [netlist_6502_adjacency_size];
+};
+
+static constexpr auto
+make_netlist_6502_adjacency ()
+{
+	static_assert (netlist_6502_adjacency_size <= 0x10000u);
+
+	nodenum_t transistor_gate [netlist_6502_transistor_count] {};
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+		for (auto k = gate_to_transistor_index [nindex]; k < gate_to_transistor_index [nindex + 1]; ++k)
+			transistor_gate [gate_to_transistor [k]] = nindex;
+
+	netlist_6502_adjacency_type result {};
+	std::size_t at { 0u };
+
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+	{
+		result.index [nindex] = std::uint16_t (at);
+		auto* record = &result.data [at];
+		record [adjacency_gates]				= gate_to_transistor_index	[nindex + 1] - gate_to_transistor_index	[nindex];
+		record [adjacency_bridges]			= node_bridge_index					[nindex + 1] - node_bridge_index				[nindex];
+		record [adjacency_depends_lhs]	= node_depends_lhs_index		[nindex + 1] - node_depends_lhs_index		[nindex];
+		record [adjacency_depends_rhs]	= node_depends_rhs_index		[nindex + 1] - node_depends_rhs_index		[nindex];
+		at += adjacency_header;
+
+		for (auto k = gate_to_transistor_index [nindex]; k < gate_to_transistor_index [nindex + 1]; ++k)
+		{
+			result.data [at++] = gate_to_transistor [k];
+			result.data [at++] = netlist_6502_components.transistor_slot [gate_to_transistor [k]];
+		}
+		for (auto k = node_bridge_index [nindex]; k < node_bridge_index [nindex + 1]; ++k)
+		{
+			result.data [at++] = node_bridge [k].first;
+			result.data [at++] = transistor_gate [node_bridge [k].first];
+			result.data [at++] = node_bridge [k].second;
+		}
+		for (auto k = node_depends_lhs_index [nindex]; k < node_depends_lhs_index [nindex + 1]; ++k)
+			result.data [at++] = node_depends_lhs [k];
+		for (auto k = node_depends_rhs_index [nindex]; k < node_depends_rhs_index [nindex + 1]; ++k)
+			result.data [at++] = node_depends_rhs [k];
+	}
+
+	return result;
+}
+
+static inline constexpr auto netlist_6502_adjacency = make_netlist_6502_adjacency ();
+
+struct node_adjacency
+{
+	constexpr node_adjacency (nodenum_t nindex)
+	: record { &netlist_6502_adjacency.data [netlist_6502_adjacency.index [nindex]] }
+	{}
+
+	constexpr auto gates () const
+	{
+		return strided_range<std::uint16_t, 2> { record + adjacency_header, record [adjacency_gates] };
+	}
+
+	constexpr auto bridges () const
+	{
+		return strided_range<std::uint16_t, 3> { record + adjacency_header + record [adjacency_gates] * 2u, record [adjacency_bridges] };
+	}
+
+	constexpr auto depends (bool value) const
+	{
+		const auto* first = record + adjacency_header + record [adjacency_gates] * 2u + record [adjacency_bridges] * 3u;
+		if (value)
+			return std::span { first, record [adjacency_depends_lhs] };
+		return std::span { first + record [adjacency_depends_lhs], record [adjacency_depends_rhs] };
+	}
+
+private:
+	const std::uint16_t* record;
+};
@@ -0,0 +1,262 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+/*
+ * The fused adjacency records again, as bytes: every field of an entry
+ * is stored as the zigzag varint of its difference to the same field of
+ * the entry before, the first entry of a list starts from the node the
+ * record belongs to. Neighbours of a node tend to have nearby numbers,
+ * so most fields fit in a single byte. A record is
+ *
+ *   gate bytes, bridge bytes, lhs bytes	as varints
+ *   gates, bridges, lhs, rhs						as the deltas above
+ *
+ * the rhs list runs up to the record of the next node. Every list keeps
+ * the order of the fused records: dependents are queued in that order
+ * and the group search visits bridges in it, and both are observable.
+ */
+
+static constexpr void
+varint_write (std::uint8_t* data, std::size_t& at, std::uint32_t value)
+{
+	while (value >= 0x80u)
+	{
+		if (data)
+			data [at] = std::uint8_t (value | 0x80u);
+		++at;
+		value >>= 7u;
+	}
+	if (data)
+		data [at] = std::uint8_t (value);
+	++at;
+}
+
+static constexpr auto
+varint_read (const std::uint8_t*& at) -> std::uint32_t
+{
+	std::uint32_t value { 0u };
+	for (unsigned shift = 0u; ; shift += 7u)
+	{
+		const auto byte = *at++;
+		value |= std::uint32_t (byte & 0x7fu) << shift;
+		if (!(byte & 0x80u))
+			return value;
+	}
+}
+
+static constexpr auto
+zigzag_encode (int value) -> std::uint32_t
+{
+	return value < 0 ? (std::uint32_t (-(value + 1)) << 1u) | 1u : std::uint32_t (value) << 1u;
+}
+
+static constexpr auto
+zigzag_decode (std::uint32_t value) -> int
+{
+	return (value & 1u) ? -int (value >> 1u) - 1 : int (value >> 1u);
+}
+
+/* one list of a record, _Arity fields per entry, nothing written when data is null */
+template <std::size_t _Arity>
+static constexpr void
+delta_list_write (std::uint8_t* data, std::size_t& at, nodenum_t origin, 
+	const std::uint16_t* first, std::size_t count)
+{
+	int last [_Arity] {};
+	for (auto&& field : last)
+		field = origin;
+	for (std::size_t i = 0u; i < count * _Arity; ++i)
+	{
+		varint_write (data, at, zigzag_encode (first [i] - last [i % _Arity]));
+		last [i % _Arity] = first [i];
+	}
+}
+
+/* writes all records and returns their size, only measures when data is null */
+static constexpr auto
+netlist_6502_compact_write (std::uint8_t* data, std::uint16_t* index) -> std::size_t
+{
+	std::size_t at { 0u };
+
+	std::uint16_t gates [netlist_6502_transistor_count * 2u] {};
+	std::uint16_t bridges [netlist_6502_transistor_count * 3u] {};
+	std::uint16_t depends [2][netlist_6502_node_count] {};
+
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+	{
+		const node_adjacency adjacency { nindex };
+		std::size_t counts [4] {};
+
+		for (auto&& [transistor, slot] : adjacency.gates ())
+		{
+			gates [counts [0] * 2u + 0u] = transistor;
+			gates [counts [0] * 2u + 1u] = slot;
+			++counts [0];
+		}
+		for (auto&& [transistor, gate, other] : adjacency.bridges ())
+		{
+			bridges [counts [1] * 3u + 0u] = transistor;
+			bridges [counts [1] * 3u + 1u] = gate;
+			bridges [counts [1] * 3u + 2u] = other;
+			++counts [1];
+		}
+		for (const bool value : { true, false })
+		{
+			auto&& list = depends [!value];
+			auto&& count = counts [2 + !value];
+			for (auto&& dependent : adjacency.depends (value))
+				list [count++] = dependent;
+		}
+
+		std::size_t sizes [3] {};
+		delta_list_write<2> (nullptr, sizes [0], nindex, gates, counts [0]);
+		delta_list_write<3> (nullptr, sizes [1], nindex, bridges, counts [1]);
+		delta_list_write<1> (nullptr, sizes [2], nindex, depends [0], counts [2]);
+
+		if (index)
+			index [nindex] = std::uint16_t (at);
+		for (auto size : sizes)
+			varint_write (data, at, std::uint32_t (size));
+		delta_list_write<2> (data, at, nindex, gates, counts [0]);
+		delta_list_write<3> (data, at, nindex, bridges, counts [1]);
+		delta_list_write<1> (data, at, nindex, depends [0], counts [2]);
+		delta_list_write<1> (data, at, nindex, depends [1], counts [3]);
+	}
+
+	if (index)
+		index [netlist_6502_node_count] = std::uint16_t (at);
+	return at;
+}
+
+static inline constexpr auto netlist_6502_compact_size = netlist_6502_compact_write (nullptr, nullptr);
+
+struct netlist_6502_compact_type
+{
+	std::uint16_t index [netlist_6502_node_count + 1];
+	std::uint8_t data [netlist_6502_compact_size];
+};
+
+static constexpr auto
+make_netlist_6502_compact ()
+{
+	static_assert (netlist_6502_compact_size < 0x10000u);
+
+	netlist_6502_compact_type result {};
+	netlist_6502_compact_write (result.data, result.index);
+	return result;
+}
+
+static inline constexpr auto netlist_6502_compact = make_netlist_6502_compact ();
+
+/* decodes one list while it's walked, entries come out like the fused ones */
+template <std::size_t _Arity>
+struct delta_range
+{
+	using value_type = std::conditional_t<_Arity == 1u, std::uint16_t, std::array<std::uint16_t, _Arity>>;
+
+	struct iterator
+	{
+		constexpr iterator (const std::uint8_t* _at, const std::uint8_t* _last, nodenum_t origin)
+		: _at		{ _at },
+			_next	{ _at },
+			_last	{ _last }
+		{
+			_entry.fill (origin);
+			decode ();
+		}
+
+		constexpr auto operator * () const -> value_type
+		{
+			if constexpr (_Arity == 1u)
+				return _entry [0];
+			else
+				return _entry;
+		}
+
+		constexpr auto& operator ++ () 
+		{ 
+			_at = _next;
+			decode ();
+			return *this; 
+		}
+
+		constexpr bool operator == (const iterator& rhs) const { return _at == rhs._at; }
+
+	private:
+		constexpr void decode ()
+		{
+			if (_next == _last)
+				return;
+			for (auto&& field : _entry)
+				field = std::uint16_t (field + zigzag_decode (varint_read (_next)));
+		}
+
+		const std::uint8_t* _at;
+		const std::uint8_t* _next;
+		const std::uint8_t* _last;
+		std::array<std::uint16_t, _Arity> _entry;
+	};
+
+	constexpr auto begin ()	const { return iterator (_first, _last, _origin); }
+	constexpr auto end ()		const { return iterator (_last, _last, _origin); }
+
+	const std::uint8_t* _first;
+	const std::uint8_t* _last;
+	nodenum_t _origin;
+};
+
+/* same interface as node_adjacency */
+struct node_adjacency_compact
+{
+	constexpr node_adjacency_compact (nodenum_t nindex)
+	: origin { nindex }
+	{
+		const auto* at = &netlist_6502_compact.data [netlist_6502_compact.index [nindex]];
+		const auto gate_bytes = varint_read (at);
+		const auto bridge_bytes = varint_read (at);
+		const auto lhs_bytes = varint_read (at);
+		gates_first = at;
+		bridges_first = gates_first + gate_bytes;
+		lhs_first = bridges_first + bridge_bytes;
+		rhs_first = lhs_first + lhs_bytes;
+		rhs_last = &netlist_6502_compact.data [netlist_6502_compact.index [nindex + 1]];
+	}
+
+	constexpr auto gates () const { return delta_range<2> { gates_first, bridges_first, origin }; }
+	constexpr auto bridges () const { return delta_range<3> { bridges_first, lhs_first, origin }; }
+
+	constexpr auto depends (bool value) const
+	{
+		if (value)
+			return delta_range<1> { lhs_first, rhs_first, origin };
+		return delta_range<1> { rhs_first, rhs_last, origin };
+	}
+
+private:
+	nodenum_t origin;
+	const std::uint8_t* gates_first;
+	const std::uint8_t* bridges_first;
+	const std::uint8_t* lhs_first;
+	const std::uint8_t* rhs_first;
+	const std::uint8_t* rhs_last;
+};
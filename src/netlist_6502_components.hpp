@@ -0,0 +1,153 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+/*
+ * Static channel-connected components of the netlist: nodes that can
+ * ever end up in the same group, because some set of transistors joins
+ * them. vcc and vss are not members of any component, a transistor to
+ * a supply belongs to the component of its other end.
+ *
+ * Every transistor is assigned a counter slot, the engine keeps the
+ * number of conducting transistors per slot. Transistors between two
+ * nodes count towards their component, so a node whose component has
+ * no conducting one is known to be a group of its own. Transistors to
+ * vss or vcc count towards the node itself, which then tells the value
+ * of such a single node group.
+ */
+
+enum bridge_kind_t
+{
+	bridge_internal,
+	bridge_to_vss,
+	bridge_to_vcc,
+	bridge_kinds
+};
+
+/* vcc and vss share this spare component, which is never solved as a group */
+static inline constexpr auto netlist_6502_supply_component = netlist_6502_node_count;
+static inline constexpr auto netlist_6502_component_slots = (netlist_6502_node_count + 1) * bridge_kinds;
+
+struct netlist_6502_components_type
+{
+	nodenum_t node_component [netlist_6502_node_count];
+	std::uint16_t transistor_slot [netlist_6502_transistor_count];
+
+	/* members of every component, indexed by component */
+	nodenum_t component_nodes_index [netlist_6502_node_count + 2];
+	nodenum_t component_nodes [netlist_6502_node_count];
+
+	/* both ends of every transistor */
+	std::pair<nodenum_t, nodenum_t> transistor_nodes [netlist_6502_transistor_count];
+};
+
+static constexpr auto
+make_netlist_6502_components ()
+{
+	using namespace node_names;
+
+	netlist_6502_components_type result {};
+	nodenum_t parent [netlist_6502_node_count] {};
+
+	for (nodenum_t i = 0u; i < netlist_6502_node_count; ++i)
+		parent [i] = i;
+
+	const auto find = [&parent] (nodenum_t nindex)
+	{
+		while (parent [nindex] != nindex)
+			nindex = parent [nindex] = parent [parent [nindex]];
+		return nindex;
+	};
+
+	/* union over all bridges, the lowest node number names the component */
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+	{
+		if (one_of<vcc, vss> (nindex))
+			continue;
+		for (auto k = node_bridge_index [nindex]; k < node_bridge_index [nindex + 1]; ++k)
+		{
+			const auto other = node_bridge [k].second;
+			if (one_of<vcc, vss> (other))
+				continue;
+			const auto lhs = find (nindex);
+			const auto rhs = find (other);
+			parent [std::max (lhs, rhs)] = std::min (lhs, rhs);
+		}
+	}
+
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+		result.node_component [nindex] = one_of<vcc, vss> (nindex) ? netlist_6502_supply_component : find (nindex);
+
+	/* counting sort of the nodes by component */
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+		++result.component_nodes_index [result.node_component [nindex] + 1];
+	for (auto i = 0u; i < netlist_6502_node_count + 1; ++i)
+		result.component_nodes_index [i + 1] += result.component_nodes_index [i];
+
+	nodenum_t fill [netlist_6502_node_count + 1] {};
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+	{
+		const auto component = result.node_component [nindex];
+		result.component_nodes [result.component_nodes_index [component] + fill [component]++] = nindex;
+	}
+
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+	{
+		if (one_of<vcc, vss> (nindex))
+			continue;
+		for (auto k = node_bridge_index [nindex]; k < node_bridge_index [nindex + 1]; ++k)
+		{
+			const auto [tindex, other] = node_bridge [k];
+			result.transistor_nodes [tindex] = { nindex, other };
+			if (other == vss)
+				result.transistor_slot [tindex] = nindex * bridge_kinds + bridge_to_vss;
+			else if (other == vcc)
+				result.transistor_slot [tindex] = nindex * bridge_kinds + bridge_to_vcc;
+			else
+				result.transistor_slot [tindex] = result.node_component [nindex] * bridge_kinds + bridge_internal;
+		}
+	}
+
+	return result;
+}
+
+static inline constexpr auto netlist_6502_components = make_netlist_6502_components ();
+
+/* nodes that are a component of their own, they never join another node */
+static constexpr auto
+make_netlist_6502_single_nodes ()
+{
+	using namespace node_names;
+
+	bitmap<netlist_6502_node_count> result;
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+	{
+		const auto component = netlist_6502_components.node_component [nindex];
+		const auto members = 
+			netlist_6502_components.component_nodes_index [component + 1] - 
+			netlist_6502_components.component_nodes_index [component];
+		result.set (nindex, !one_of<vcc, vss> (nindex) && members == 1u);
+	}
+	return result;
+}
+
+static inline constexpr auto netlist_6502_single_nodes = make_netlist_6502_single_nodes ();
@@ -0,0 +1,369 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <span>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "utils/bitmap.hpp"
+#include "utils/range.hpp"
+#include "utils/misc.hpp"
+
+#include "types.hpp"
+#include "netlist_6502_labels.hpp"
+#include "netlist_6502_transdefs.inl"
+#include "netlist_6502_components.hpp"
+#include "netlist_6502_adjacency.hpp"
+#include "netlist_6502_jit.hpp"
+
+#if PERFECT6502_HAS_JIT
+
+static_assert (offsetof (netlist_6502_jit_context, live_bridges)		== 0);
+static_assert (offsetof (netlist_6502_jit_context, is_connected)		== 8);
+static_assert (offsetof (netlist_6502_jit_context, output_marks)		== 16);
+static_assert (offsetof (netlist_6502_jit_context, output_items)		== 24);
+static_assert (offsetof (netlist_6502_jit_context, output_size)			== 32);
+static_assert (offsetof (netlist_6502_jit_context, group_marks)			== 40);
+static_assert (offsetof (netlist_6502_jit_context, conducting)			== 48);
+static_assert (offsetof (netlist_6502_jit_context, group_items)			== 56);
+static_assert (offsetof (netlist_6502_jit_context, group_size)			== 64);
+static_assert (offsetof (netlist_6502_jit_context, group_supplies)	== 72);
+
+/*
+ * Just the handful of instructions the generated functions are made of.
+ * Only registers both calling conventions let a callee clobber are used.
+ *
+ * node updates: r8 live_bridges, r9 is_connected, r10 output marks,
+ * r11 output items, rdx the output size and rax its value
+ *
+ * group searches: r8 group marks, r9 conducting, r10 group items,
+ * rax the group size, ecx the supplies reached, rdx and r11 are kept
+ * for the entry to write back the results
+ */
+struct x86_64_emitter
+{
+	std::vector<std::uint8_t> bytes;
+
+	/* rel32 operands of calls, patched once every function has its place */
+	std::vector<std::pair<std::size_t, nodenum_t>> calls;
+
+	void emit (std::initializer_list<std::uint8_t> what)
+	{
+		bytes.insert (bytes.end (), what);
+	}
+
+	template <typename _Value>
+	void emit_value (_Value value)
+	{
+		std::uint8_t raw [sizeof (value)];
+		std::memcpy (raw, &value, sizeof (value));
+		bytes.insert (bytes.end (), std::begin (raw), std::end (raw));
+	}
+
+	/* rdi or rcx, whichever holds the first argument */
+	static constexpr std::uint8_t argument ()
+	{
+#if defined(_WIN32)
+		return 0x01;
+#else
+		return 0x07;
+#endif
+	}
+
+	/* mov r8, [arg] ; mov r9, [arg + 8] ; mov r10, [arg + 16] ; mov r11, [arg + 24] ; mov rdx, [arg + 32] ; mov rax, [rdx] */
+	void load_update_context ()
+	{
+		emit ({ 0x4c, 0x8b, std::uint8_t (0x00 | argument ()) });
+		emit ({ 0x4c, 0x8b, std::uint8_t (0x48 | argument ()), 0x08 });
+		emit ({ 0x4c, 0x8b, std::uint8_t (0x50 | argument ()), 0x10 });
+		emit ({ 0x4c, 0x8b, std::uint8_t (0x58 | argument ()), 0x18 });
+		emit ({ 0x48, 0x8b, std::uint8_t (0x50 | argument ()), 0x20 });
+		emit ({ 0x48, 0x8b, 0x02 });
+	}
+
+	/* mov [rdx], rax */
+	void store_output_size ()
+	{
+		emit ({ 0x48, 0x89, 0x02 });
+	}
+
+	/* add/sub word [r8 + disp32], 1 */
+	void count_slot (std::size_t slot, bool up)
+	{
+		emit ({ 0x66, 0x41, 0x83, std::uint8_t (up ? 0x80 : 0xa8) });
+		emit_value (std::int32_t (slot * sizeof (std::uint16_t)));
+		emit ({ 0x01 });
+	}
+
+	/* mov rcx, mask ; or/and [r9 + disp32], rcx */
+	void update_connected (std::size_t word, std::uint64_t mask, bool set)
+	{
+		emit ({ 0x48, 0xb9 });
+		emit_value (set ? mask : ~mask);
+		emit ({ 0x49, std::uint8_t (set ? 0x09 : 0x21), 0x89 });
+		emit_value (std::int32_t (word * sizeof (std::uint64_t)));
+	}
+
+	/*
+	 * bts qword [base + disp32], bit ; then unless it was set already
+	 * mov word [list + rax * 2], nindex ; inc rax
+	 * base and list are r8/r10 for the group and r10/r11 for the outputs
+	 */
+	void insert_unique (std::uint8_t marks, std::uint8_t list, nodenum_t nindex)
+	{
+		emit ({ 0x49, 0x0f, 0xba, std::uint8_t (0xa8 | marks) });
+		emit_value (std::int32_t (nindex / 64u * sizeof (std::uint64_t)));
+		emit_value (std::uint8_t (nindex % 64u));
+		emit ({ 0x72, 0x0a });
+		emit ({ 0x66, 0x41, 0xc7, 0x04, std::uint8_t (0x40 | list) });
+		emit_value (std::uint16_t (nindex));
+		emit ({ 0x48, 0xff, 0xc0 });
+	}
+
+	/* the same, but returning when the node was set already */
+	void enter_group (nodenum_t nindex)
+	{
+		emit ({ 0x49, 0x0f, 0xba, 0xa8 });
+		emit_value (std::int32_t (nindex / 64u * sizeof (std::uint64_t)));
+		emit_value (std::uint8_t (nindex % 64u));
+		emit ({ 0x73, 0x01 });
+		ret ();
+		emit ({ 0x66, 0x41, 0xc7, 0x04, 0x42 });
+		emit_value (std::uint16_t (nindex));
+		emit ({ 0x48, 0xff, 0xc0 });
+	}
+
+	/* bt qword [r9 + disp32], bit ; jnc over the next `skip` bytes */
+	void if_conducting (std::size_t bit, std::uint8_t skip)
+	{
+		emit ({ 0x49, 0x0f, 0xba, 0xa1 });
+		emit_value (std::int32_t (bit / 64u * sizeof (std::uint64_t)));
+		emit_value (std::uint8_t (bit % 64u));
+		emit ({ 0x73, skip });
+	}
+
+	/* or ecx, supply */
+	void reach_supply (std::uint32_t supply)
+	{
+		emit ({ 0x83, 0xc9, std::uint8_t (supply) });
+	}
+
+	/* call the search function of a node, resolved later */
+	void call_visit (nodenum_t nindex)
+	{
+		emit ({ 0xe8 });
+		calls.emplace_back (bytes.size (), nindex);
+		emit_value (std::int32_t { 0 });
+	}
+
+	/*
+	 * mov rdx, arg ; mov r8, [rdx + 40] ; mov r9, [rdx + 48] ; mov r10, [rdx + 56] ; mov r11, [rdx + 64]
+	 * mov rax, [r11] ; xor ecx, ecx ; call visit ; mov [r11], rax ; mov [rdx + 72], ecx
+	 */
+	void group_entry (nodenum_t nindex)
+	{
+		emit ({ 0x48, 0x89, std::uint8_t (0xc2 | argument () << 3) });
+		emit ({ 0x4c, 0x8b, 0x42, 0x28 });
+		emit ({ 0x4c, 0x8b, 0x4a, 0x30 });
+		emit ({ 0x4c, 0x8b, 0x52, 0x38 });
+		emit ({ 0x4c, 0x8b, 0x5a, 0x40 });
+		emit ({ 0x49, 0x8b, 0x03 });
+		emit ({ 0x31, 0xc9 });
+		call_visit (nindex);
+		emit ({ 0x49, 0x89, 0x03 });
+		emit ({ 0x89, 0x4a, 0x48 });
+		ret ();
+	}
+
+	void ret ()
+	{
+		emit ({ 0xc3 });
+	}
+};
+
+enum : std::uint8_t
+{
+	register_r8		= 0u,
+	register_r10	= 2u,
+	register_r11	= 3u
+};
+
+static auto
+allocate_executable (const std::vector<std::uint8_t>& bytes) -> void*
+{
+#if defined(_WIN32)
+	auto* code = VirtualAlloc (nullptr, bytes.size (), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (!code)
+		return nullptr;
+	std::memcpy (code, bytes.data (), bytes.size ());
+	DWORD previous {};
+	if (!VirtualProtect (code, bytes.size (), PAGE_EXECUTE_READ, &previous))
+	{
+		VirtualFree (code, 0, MEM_RELEASE);
+		return nullptr;
+	}
+	return code;
+#else
+	auto* code = mmap (nullptr, bytes.size (), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (code == MAP_FAILED)
+		return nullptr;
+	std::memcpy (code, bytes.data (), bytes.size ());
+	if (mprotect (code, bytes.size (), PROT_READ | PROT_EXEC))
+	{
+		munmap (code, bytes.size ());
+		return nullptr;
+	}
+	return code;
+#endif
+}
+
+auto netlist_6502_jit::compile (bool store_connectivity) -> std::unique_ptr<netlist_6502_jit>
+{
+	using namespace node_names;
+	constexpr auto word_size = std::size_t (64u);
+	constexpr auto no_function = ~std::size_t (0u);
+
+	x86_64_emitter emitter;
+	std::vector<std::size_t> updates;
+	std::vector<std::size_t> entries;
+	std::vector<std::size_t> visits;
+
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+	{
+		const node_adjacency adjacency { nindex };
+
+		for (const bool value : { false, true })
+		{
+			updates.push_back (emitter.bytes.size ());
+			emitter.load_update_context ();
+
+			/* sorted by word, so each word is written once */
+			std::map<std::size_t, std::uint64_t> connected;
+
+			for (auto&& [transistor, slot] : adjacency.gates ())
+			{
+				emitter.count_slot (slot, value);
+				connected [transistor / word_size] |= std::uint64_t (1u) << (transistor % word_size);
+			}
+			if (store_connectivity)
+			{
+				for (auto&& [word, mask] : connected)
+					emitter.update_connected (word, mask, value);
+			}
+
+			for (auto&& dependent : adjacency.depends (value))
+				emitter.insert_unique (register_r10, register_r11, dependent);
+			emitter.store_output_size ();
+			emitter.ret ();
+		}
+	}
+
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+	{
+		if (one_of<vcc, vss> (nindex))
+		{
+			entries.push_back (no_function);
+			visits.push_back (no_function);
+			continue;
+		}
+
+		entries.push_back (emitter.bytes.size ());
+		emitter.group_entry (nindex);
+
+		/* the interpreter's group_add_node, with vss and vcc only noted */
+		visits.push_back (emitter.bytes.size ());
+		emitter.enter_group (nindex);
+		for (auto&& [tindex, gindex, nindex0] : node_adjacency (nindex).bridges ())
+		{
+			const auto supply = nindex0 == vss ? jit_reached_vss : nindex0 == vcc ? jit_reached_vcc : 0u;
+			emitter.if_conducting (store_connectivity ? tindex : gindex, supply ? 3u : 5u);
+			if (supply)
+				emitter.reach_supply (supply);
+			else
+				emitter.call_visit (nindex0);
+		}
+		emitter.ret ();
+	}
+
+	for (auto&& [at, nindex] : emitter.calls)
+	{
+		const auto rel = std::int32_t (visits [nindex] - (at + sizeof (std::int32_t)));
+		std::memcpy (&emitter.bytes [at], &rel, sizeof (rel));
+	}
+
+	auto* code = allocate_executable (emitter.bytes);
+	if (!code)
+		return nullptr;
+
+	std::unique_ptr<netlist_6502_jit> result { new netlist_6502_jit };
+	result->code = code;
+	result->size = emitter.bytes.size ();
+	for (auto offset : updates)
+		result->updates.push_back (reinterpret_cast<function_type> (static_cast<std::uint8_t*> (code) + offset));
+	for (auto offset : entries)
+		result->searches.push_back (offset == no_function ? nullptr : reinterpret_cast<function_type> (static_cast<std::uint8_t*> (code) + offset));
+	return result;
+}
+
+netlist_6502_jit::~netlist_6502_jit ()
+{
+#if defined(_WIN32)
+	VirtualFree (code, 0, MEM_RELEASE);
+#else
+	munmap (code, size);
+#endif
+}
+
+#else
+
+auto netlist_6502_jit::compile (bool) -> std::unique_ptr<netlist_6502_jit>
+{
+	return nullptr;
+}
+
+netlist_6502_jit::~netlist_6502_jit ()
+{ }
+
+#endif
+
+auto netlist_6502_jit::shared (bool store_connectivity) -> const netlist_6502_jit*
+{
+	/* compiled on first use, the code takes every table it writes from the context */
+	if (store_connectivity)
+	{
+		static const auto stored = compile (true);
+		return stored.get ();
+	}
+	static const auto derived = compile (false);
+	return derived.get ();
+}
@@ -0,0 +1,109 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "types.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PERFECT6502_HAS_JIT 1
+#else
+#define PERFECT6502_HAS_JIT 0
+#endif
+
+/*
+ * Native code for the two hot paths of the engine, generated once per
+ * connectivity mode and shared read-only by every instance.
+ *
+ * node_changed: what happens after a node changes its value. Every
+ * counter slot, transistor bit and dependent node of the tables is baked
+ * in as an immediate. Dependents are appended to the next wave in the
+ * order the interpreter appends them, a test-and-set on the marks drops
+ * the ones already queued.
+ *
+ * group_search: the depth first group walk as one function per node that
+ * calls the functions of its conducting neighbours, in the order of the
+ * interpreter. It only collects the members and notes whether vss or vcc
+ * was reached; the pulls and values are left to the caller.
+ */
+
+struct netlist_6502_jit_context
+{
+	/* node updates */
+	std::uint16_t* live_bridges;
+	std::uint64_t* is_connected;	/* null when connectivity is derived */
+	std::uint64_t* output_marks;
+	std::uint16_t* output_items;
+	std::size_t* output_size;
+
+	/* group searches */
+	std::uint64_t* group_marks;
+	const std::uint64_t* conducting;	/* is_connected, or the node values when connectivity is derived */
+	std::uint16_t* group_items;
+	std::size_t* group_size;
+	std::uint32_t group_supplies;
+};
+
+enum : std::uint32_t
+{
+	jit_reached_vss = 1u,
+	jit_reached_vcc = 2u
+};
+
+struct netlist_6502_jit
+{
+	using function_type = void (*) (netlist_6502_jit_context*);
+
+	/* null where the host can't run the generated code */
+	static auto shared (bool store_connectivity) -> const netlist_6502_jit*;
+
+	netlist_6502_jit (const netlist_6502_jit&) = delete;
+	netlist_6502_jit& operator = (const netlist_6502_jit&) = delete;
+ ~netlist_6502_jit ();
+
+	auto node_changed (nodenum_t nindex, bool value) const -> function_type
+	{
+		return updates [nindex * 2u + value];
+	}
+
+	/* null for vss and vcc, they never start a group */
+	auto group_search (nodenum_t nindex) const -> function_type
+	{
+		return searches [nindex];
+	}
+
+	auto code_size () const -> std::size_t { return size; }
+
+private:
+	netlist_6502_jit () = default;
+
+	static auto compile (bool store_connectivity) -> std::unique_ptr<netlist_6502_jit>;
+
+	void* code { nullptr };
+	std::size_t size { 0u };
+	std::vector<function_type> updates;
+	std::vector<function_type> searches;
+};
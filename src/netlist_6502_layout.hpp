@@ -0,0 +1,229 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+/*
+ * Storage layouts for the per node pull-up, pull-down and value flags.
+ * The engine is written against the common interface below, so the
+ * layout only decides how many cache lines a group search touches.
+ * The *_word accessors return the flags of 64 nodes at once, bit i of
+ * word w for node w * 64 + i, for evaluating whole words of nodes.
+ */
+
+/* three separate bitmaps, the densest layout */
+template <std::size_t _Num_nodes>
+struct nodes_bit_packed
+{
+	constexpr bool pullup (std::size_t index) const { return pullu.get (index); }
+	constexpr bool pulldown (std::size_t index) const { return pulld.get (index); }
+	constexpr bool value (std::size_t index) const { return values.get (index); }
+
+	constexpr auto pullup_word (std::size_t word) const -> std::uint64_t { return pullu.word (word); }
+	constexpr auto pulldown_word (std::size_t word) const -> std::uint64_t { return pulld.word (word); }
+	constexpr auto value_word (std::size_t word) const -> std::uint64_t { return values.word (word); }
+
+	/* the value bitmap itself, generated code tests gates in it directly */
+	constexpr auto value_bits () const -> const std::uint64_t* { return values.data (); }
+
+	constexpr bool try_set_value (std::size_t index, bool value) 
+	{
+		return values.try_set (index, value);
+	}
+
+	constexpr void reset (const bitmap<_Num_nodes>& pullups)
+	{
+		pullu = pullups;
+		pulld.clear ();
+		values.clear ();
+	}
+
+	template <typename _New_type, auto... _Index>
+	constexpr auto get_values () const
+	{
+		return values.template get_bits<_New_type, _Index...> ();
+	}
+
+	template <auto... _Index, typename _New_type>
+	constexpr void set_pulls (_New_type value, _New_type not_value)
+	{
+		pullu.template set_bits<_Index...> (value);
+		pulld.template set_bits<_Index...> (not_value);
+	}
+
+private:
+	bitmap<_Num_nodes> pullu;
+	bitmap<_Num_nodes> pulld;
+	bitmap<_Num_nodes> values;
+};
+
+/* one byte per node, all three flags of a node share a cache line */
+template <std::size_t _Num_nodes>
+struct nodes_byte_packed
+{
+	enum : std::uint8_t 
+	{
+		flag_value		= 1u,
+		flag_pullup		= 2u,
+		flag_pulldown	= 4u
+	};
+
+	constexpr bool pullup (std::size_t index) const { return store [index] & flag_pullup; }
+	constexpr bool pulldown (std::size_t index) const { return store [index] & flag_pulldown; }
+	constexpr bool value (std::size_t index) const { return store [index] & flag_value; }
+
+	constexpr auto pullup_word (std::size_t word) const -> std::uint64_t { return flags_word<flag_pullup> (word); }
+	constexpr auto pulldown_word (std::size_t word) const -> std::uint64_t { return flags_word<flag_pulldown> (word); }
+	constexpr auto value_word (std::size_t word) const -> std::uint64_t { return flags_word<flag_value> (word); }
+
+	constexpr bool try_set_value (std::size_t index, bool value) 
+	{
+		auto&& cell = store [index];
+		if (bool (cell & flag_value) == value)
+			return false;
+		cell ^= flag_value;
+		return true;
+	}
+
+	constexpr void reset (const bitmap<_Num_nodes>& pullups)
+	{
+		for (std::size_t i = 0u; i < _Num_nodes; ++i)
+			store [i] = pullups.get (i) ? std::uint8_t (flag_pullup) : std::uint8_t (0u);
+	}
+
+	template <typename _New_type, auto... _Index>
+	constexpr auto get_values () const
+	{
+		if constexpr (sizeof...(_Index) == 1u)
+			return value (_Index...);
+		else
+		{
+			std::uint64_t bits { 0u };
+			std::size_t bit { 0u };
+			((bits |= std::uint64_t (store [_Index] & flag_value) << bit++), ...);
+			return _New_type (bits);
+		}
+	}
+
+	template <auto... _Index, typename _New_type>
+	constexpr void set_pulls (_New_type value, _New_type)
+	{
+		const auto bits = std::uint64_t (value);
+		std::size_t bit { 0u };
+		((store [_Index] = std::uint8_t ((store [_Index] & flag_value) | 
+			((bits >> bit++) & 1u ? flag_pullup : flag_pulldown))), ...);
+	}
+
+private:
+	template <std::uint8_t _Flag>
+	constexpr auto flags_word (std::size_t word) const -> std::uint64_t
+	{
+		std::uint64_t bits { 0u };
+		const auto first = word * 64u;
+		const auto last = std::min<std::size_t> (first + 64u, _Num_nodes);
+		for (auto i = first; i < last; ++i)
+			bits |= std::uint64_t (!!(store [i] & _Flag)) << (i - first);
+		return bits;
+	}
+
+	std::uint8_t store [_Num_nodes] {};
+};
+
+/*
+ * A node has no pull, a pull-up or a pull-down, never both, so the pulls
+ * take two bits per node. The value can't be folded into the same two
+ * bits, a pulled node may still be driven either way, so it stays a
+ * bitmap of its own.
+ */
+template <std::size_t _Num_nodes>
+struct nodes_pull_coded
+{
+	enum : std::uint64_t
+	{
+		pull_none	= 0u,
+		pull_up		= 1u,
+		pull_down	= 2u
+	};
+
+	static inline constexpr auto nodes_per_word = 32u;
+
+	constexpr bool pullup (std::size_t index) const { return pull (index) == pull_up; }
+	constexpr bool pulldown (std::size_t index) const { return pull (index) == pull_down; }
+	constexpr bool value (std::size_t index) const { return values.get (index); }
+
+	constexpr auto pullup_word (std::size_t word) const -> std::uint64_t { return pulls_word (word, pull_up); }
+	constexpr auto pulldown_word (std::size_t word) const -> std::uint64_t { return pulls_word (word, pull_down); }
+	constexpr auto value_word (std::size_t word) const -> std::uint64_t { return values.word (word); }
+
+	constexpr bool try_set_value (std::size_t index, bool value) 
+	{
+		return values.try_set (index, value);
+	}
+
+	constexpr void reset (const bitmap<_Num_nodes>& pullups)
+	{
+		for (auto&& cell : pulls)
+			cell = 0u;
+		for (std::size_t i = 0u; i < _Num_nodes; ++i)
+			set_pull (i, pullups.get (i) ? pull_up : pull_none);
+		values.clear ();
+	}
+
+	template <typename _New_type, auto... _Index>
+	constexpr auto get_values () const
+	{
+		return values.template get_bits<_New_type, _Index...> ();
+	}
+
+	template <auto... _Index, typename _New_type>
+	constexpr void set_pulls (_New_type value, _New_type)
+	{
+		const auto bits = std::uint64_t (value);
+		std::size_t bit { 0u };
+		(set_pull (_Index, (bits >> bit++) & 1u ? pull_up : pull_down), ...);
+	}
+
+private:
+	constexpr auto pull (std::size_t index) const -> std::uint64_t
+	{
+		return (pulls [index / nodes_per_word] >> (index % nodes_per_word * 2u)) & 3u;
+	}
+
+	/* one bit of every two bit code, the codes never have both bits set */
+	constexpr auto pulls_word (std::size_t word, std::uint64_t code) const -> std::uint64_t
+	{
+		const auto mask = 0x5555555555555555ull * code;
+		const auto low = bit_extract (pulls [word * 2u] & mask, mask);
+		if (word * 2u + 1u >= std::size (pulls))
+			return low;
+		return low | (bit_extract (pulls [word * 2u + 1u] & mask, mask) << nodes_per_word);
+	}
+
+	constexpr void set_pull (std::size_t index, std::uint64_t code)
+	{
+		const auto shift = index % nodes_per_word * 2u;
+		auto&& cell = pulls [index / nodes_per_word];
+		cell = (cell & ~(std::uint64_t (3u) << shift)) | (code << shift);
+	}
+
+	std::uint64_t pulls [(_Num_nodes + nodes_per_word - 1u) / nodes_per_word] {};
+	bitmap<_Num_nodes> values;
+};
@@ -0,0 +1,43 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+/* mnemonic and addressing mode of every NMOS 6502 opcode, undocumented ones included */
+static inline constexpr const char* const netlist_6502_opcode_names [256] =
+{
+	"BRK", "ORA (zp,x)", "JAM", "SLO (zp,x)", "NOP zp", "ORA zp", "ASL zp", "SLO zp", "PHP", "ORA #", "ASL a", "ANC #", "NOP abs", "ORA abs", "ASL abs", "SLO abs",
+	"BPL rel", "ORA (zp),y", "JAM", "SLO (zp),y", "NOP zp,x", "ORA zp,x", "ASL zp,x", "SLO zp,x", "CLC", "ORA abs,y", "NOP", "SLO abs,y", "NOP abs,x", "ORA abs,x", "ASL abs,x", "SLO abs,x",
+	"JSR abs", "AND (zp,x)", "JAM", "RLA (zp,x)", "BIT zp", "AND zp", "ROL zp", "RLA zp", "PLP", "AND #", "ROL a", "ANC #", "BIT abs", "AND abs", "ROL abs", "RLA abs",
+	"BMI rel", "AND (zp),y", "JAM", "RLA (zp),y", "NOP zp,x", "AND zp,x", "ROL zp,x", "RLA zp,x", "SEC", "AND abs,y", "NOP", "RLA abs,y", "NOP abs,x", "AND abs,x", "ROL abs,x", "RLA abs,x",
+	"RTI", "EOR (zp,x)", "JAM", "SRE (zp,x)", "NOP zp", "EOR zp", "LSR zp", "SRE zp", "PHA", "EOR #", "LSR a", "ALR #", "JMP abs", "EOR abs", "LSR abs", "SRE abs",
+	"BVC rel", "EOR (zp),y", "JAM", "SRE (zp),y", "NOP zp,x", "EOR zp,x", "LSR zp,x", "SRE zp,x", "CLI", "EOR abs,y", "NOP", "SRE abs,y", "NOP abs,x", "EOR abs,x", "LSR abs,x", "SRE abs,x",
+	"RTS", "ADC (zp,x)", "JAM", "RRA (zp,x)", "NOP zp", "ADC zp", "ROR zp", "RRA zp", "PLA", "ADC #", "ROR a", "ARR #", "JMP (abs)", "ADC abs", "ROR abs", "RRA abs",
+	"BVS rel", "ADC (zp),y", "JAM", "RRA (zp),y", "NOP zp,x", "ADC zp,x", "ROR zp,x", "RRA zp,x", "SEI", "ADC abs,y", "NOP", "RRA abs,y", "NOP abs,x", "ADC abs,x", "ROR abs,x", "RRA abs,x",
+	"NOP #", "STA (zp,x)", "NOP #", "SAX (zp,x)", "STY zp", "STA zp", "STX zp", "SAX zp", "DEY", "NOP #", "TXA", "ANE #", "STY abs", "STA abs", "STX abs", "SAX abs",
+	"BCC rel", "STA (zp),y", "JAM", "SHA (zp),y", "STY zp,x", "STA zp,x", "STX zp,y", "SAX zp,y", "TYA", "STA abs,y", "TXS", "TAS abs,y", "SHY abs,x", "STA abs,x", "SHX abs,y", "SHA abs,y",
+	"LDY #", "LDA (zp,x)", "LDX #", "LAX (zp,x)", "LDY zp", "LDA zp", "LDX zp", "LAX zp", "TAY", "LDA #", "TAX", "LXA #", "LDY abs", "LDA abs", "LDX abs", "LAX abs",
+	"BCS rel", "LDA (zp),y", "JAM", "LAX (zp),y", "LDY zp,x", "LDA zp,x", "LDX zp,y", "LAX zp,y", "CLV", "LDA abs,y", "TSX", "LAS abs,y", "LDY abs,x", "LDA abs,x", "LDX abs,y", "LAX abs,y",
+	"CPY #", "CMP (zp,x)", "NOP #", "DCP (zp,x)", "CPY zp", "CMP zp", "DEC zp", "DCP zp", "INY", "CMP #", "DEX", "SBX #", "CPY abs", "CMP abs", "DEC abs", "DCP abs",
+	"BNE rel", "CMP (zp),y", "JAM", "DCP (zp),y", "NOP zp,x", "CMP zp,x", "DEC zp,x", "DCP zp,x", "CLD", "CMP abs,y", "NOP", "DCP abs,y", "NOP abs,x", "CMP abs,x", "DEC abs,x", "DCP abs,x",
+	"CPX #", "SBC (zp,x)", "NOP #", "ISC (zp,x)", "CPX zp", "SBC zp", "INC zp", "ISC zp", "INX", "SBC #", "NOP", "SBC #", "CPX abs", "SBC abs", "INC abs", "ISC abs",
+	"BEQ rel", "SBC (zp),y", "JAM", "ISC (zp),y", "NOP zp,x", "SBC zp,x", "INC zp,x", "ISC zp,x", "SED", "SBC abs,y", "NOP", "ISC abs,y", "NOP abs,x", "SBC abs,x", "INC abs,x", "ISC abs,x",
+};
@@ -0,0 +1,150 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+/*
+ * The decode PLA, the NOR gates that turn the instruction register and
+ * the timing state into control lines. A row pulls low as soon as any
+ * of its inputs is high, so with all inputs packed in one word a row is
+ * a single test against its own input mask.
+ *
+ * Nothing here is named by hand: the inputs are everything that feeds a
+ * pulled-up NOR gate together with one of the notir lines, that is the
+ * eight notir lines, the matching positive lines and the timing lines,
+ * the rows are the NOR gates fed by those inputs only.
+ */
+
+struct netlist_6502_pla_type
+{
+	static inline constexpr auto max_inputs = 32u;
+	static inline constexpr auto no_input = std::uint8_t (0xffu);
+
+	nodenum_t inputs [max_inputs];
+	std::size_t input_count;
+
+	/* bit of every input node in the packed word, no_input elsewhere */
+	std::uint8_t input_bit [netlist_6502_node_count];
+
+	/* inputs of every row, the rows themselves and their transistors */
+	std::uint32_t row_inputs [netlist_6502_node_count];
+	bitmap<netlist_6502_node_count> rows;
+	bitmap<netlist_6502_transistor_count> transistors;
+	std::size_t row_count;
+};
+
+static constexpr auto
+make_netlist_6502_pla ()
+{
+	using namespace node_names;
+
+	nodenum_t transistor_gate [netlist_6502_transistor_count] {};
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+		for (auto k = gate_to_transistor_index [nindex]; k < gate_to_transistor_index [nindex + 1]; ++k)
+			transistor_gate [gate_to_transistor [k]] = nindex;
+
+	/* pulled up, alone in its component and only ever pulled down */
+	const auto is_nor_gate = [] (nodenum_t nindex)
+	{
+		if (!netlist_6502_single_nodes.get (nindex) || !netlist_6502_initial_state.get (nindex))
+			return false;
+		if (node_bridge_index [nindex] == node_bridge_index [nindex + 1])
+			return false;
+		for (auto k = node_bridge_index [nindex]; k < node_bridge_index [nindex + 1]; ++k)
+			if (node_bridge [k].second != vss)
+				return false;
+		return true;
+	};
+
+	netlist_6502_pla_type result {};
+	for (auto&& bit : result.input_bit)
+		bit = netlist_6502_pla_type::no_input;
+
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+	{
+		if (!is_nor_gate (nindex))
+			continue;
+
+		bool decodes_ir { false };
+		for (auto k = node_bridge_index [nindex]; k < node_bridge_index [nindex + 1]; ++k)
+			decodes_ir |= one_of<notir0, notir1, notir2, notir3, notir4, notir5, notir6, notir7> (transistor_gate [node_bridge [k].first]);
+		if (!decodes_ir)
+			continue;
+
+		for (auto k = node_bridge_index [nindex]; k < node_bridge_index [nindex + 1]; ++k)
+		{
+			const auto gate = transistor_gate [node_bridge [k].first];
+			if (result.input_bit [gate] != netlist_6502_pla_type::no_input)
+				continue;
+			if (result.input_count < netlist_6502_pla_type::max_inputs)
+			{
+				result.input_bit [gate] = std::uint8_t (result.input_count);
+				result.inputs [result.input_count] = gate;
+			}
+			++result.input_count;
+		}
+	}
+
+	for (nodenum_t nindex = 0u; nindex < netlist_6502_node_count; ++nindex)
+	{
+		if (!is_nor_gate (nindex) || result.input_bit [nindex] != netlist_6502_pla_type::no_input)
+			continue;
+
+		std::uint32_t mask { 0u };
+		bool decoded { true };
+		for (auto k = node_bridge_index [nindex]; k < node_bridge_index [nindex + 1]; ++k)
+		{
+			const auto bit = result.input_bit [transistor_gate [node_bridge [k].first]];
+			decoded &= bit != netlist_6502_pla_type::no_input;
+			mask |= decoded ? std::uint32_t (1u) << bit : 0u;
+		}
+		if (!decoded)
+			continue;
+
+		result.rows.set (nindex, true);
+		result.row_inputs [nindex] = mask;
+		for (auto k = node_bridge_index [nindex]; k < node_bridge_index [nindex + 1]; ++k)
+			result.transistors.set (node_bridge [k].first, true);
+		++result.row_count;
+	}
+
+	return result;
+}
+
+static inline constexpr auto netlist_6502_pla = make_netlist_6502_pla ();
+static_assert (netlist_6502_pla.input_count <= netlist_6502_pla_type::max_inputs, "decode inputs don't fit in one word");
+
+/*
+ * Rows queued for one wave, in the order they were queued, each with
+ * the frontier position the wave reaches it at
+ */
+struct netlist_6502_pla_wave
+{
+	array_list<std::pair<std::uint16_t, nodenum_t>, netlist_6502_node_count> rows;
+	bitmap<netlist_6502_node_count> queued;
+
+	constexpr void clear ()
+	{
+		for (auto&& [position, row] : rows)
+			queued.set (row, false);
+		rows.clear ();
+	}
+};
@@ -0,0 +1,198 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include <algorithm>
+
+#include "netlist_6502_opcodes.hpp"
+#include "netlist_6502_profile.hpp"
+
+/* deeper calls than this are charged to the deepest frame */
+static inline constexpr std::size_t profile_max_frames = 256u;
+
+void netlist_6502_profile_cost::add (const netlist_6502_profile_cost& other)
+{
+	half_cycles += other.half_cycles;
+	seconds += other.seconds;
+	waves += other.waves;
+	groups += other.groups;
+	nodes_flipped += other.nodes_flipped;
+}
+
+void netlist_6502_profile::sample (const netlist_6502& cpu, const std::uint8_t* memory, double seconds)
+{
+	const auto counters = cpu.counters ();
+	const netlist_6502_profile_cost cost {
+		1u, seconds,
+		counters.waves - last.waves,
+		counters.groups - last.groups,
+		counters.nodes_flipped - last.nodes_flipped
+	};
+	last = counters;
+
+	const auto sync = cpu.sync ();
+	if (sync && !fetching)
+		start_instruction (cpu, memory);
+	fetching = sync;
+
+	total.add (cost);
+	if (!started)
+		return;
+	addresses [address].cost.add (cost);
+	opcodes [opcode].cost.add (cost);
+	tree [frames.empty () ? 0u : frames.back ().node].self.add (cost);
+}
+
+void netlist_6502_profile::start_instruction (const netlist_6502& cpu, const std::uint8_t* memory)
+{
+	started = true;
+	address = cpu.address ();
+	opcode = memory [address];
+	++addresses [address].count;
+	addresses [address].opcode = opcode;
+	++opcodes [opcode].count;
+	++instructions;
+
+	const auto stack = cpu.s ();
+	if (calling && frames.size () < profile_max_frames)
+	{
+		const auto node = child (frames.empty () ? 0u : frames.back ().node, address);
+		++tree [node].calls;
+		frames.push_back ({ node, calling_stack });
+	}
+	calling = false;
+
+	/* the stack is back where it was before the call, or above */
+	while (!frames.empty () && stack >= frames.back ().stack)
+		frames.pop_back ();
+
+	if (opcode == 0x20 || opcode == 0x00)
+	{
+		calling = true;
+		calling_stack = stack;
+	}
+}
+
+auto netlist_6502_profile::child (std::size_t parent, std::uint16_t address) -> std::size_t
+{
+	const auto key = std::uint64_t (parent) << 16u | address;
+	const auto found = tree_index.find (key);
+	if (found != tree_index.end ())
+		return found->second;
+
+	tree.push_back ({ address, parent, 0u, {}, {} });
+	tree [parent].children.push_back (tree.size () - 1u);
+	tree_index.emplace (key, tree.size () - 1u);
+	return tree.size () - 1u;
+}
+
+void netlist_6502_profile::inclusive (std::vector<netlist_6502_profile_cost>& costs) const
+{
+	/* children always come after their parent */
+	costs.resize (tree.size ());
+	for (std::size_t node = tree.size (); node-- > 0u; )
+	{
+		costs [node].add (tree [node].self);
+		if (node)
+			costs [tree [node].parent].add (costs [node]);
+	}
+}
+
+static void
+report_entry (std::FILE* file, std::uint64_t count, const netlist_6502_profile_cost& cost, double total)
+{
+	const auto per = double (std::max<std::uint64_t> (count, 1u));
+	std::fprintf (file, " %10llu %6.2f %% %10.3f %8.0f %8.1f %8.1f %8.1f %8.1f\n",
+		(unsigned long long)count, cost.seconds * 100.0 / total, cost.seconds * 1e3,
+		cost.seconds * 1e9 / double (std::max<std::uint64_t> (cost.half_cycles, 1u)), double (cost.half_cycles) / per,
+		double (cost.waves) / per, double (cost.groups) / per, double (cost.nodes_flipped) / per);
+}
+
+void netlist_6502_profile::report (std::FILE* file, std::size_t rows, std::size_t depth) const
+{
+	const auto seconds = std::max (total.seconds, 1e-12);
+	std::fprintf (file, "%llu half-cycles, %llu instructions, %.3f s, %.0f ns per half-cycle\n",
+		(unsigned long long)total.half_cycles, (unsigned long long)instructions, total.seconds,
+		total.seconds * 1e9 / double (std::max<std::uint64_t> (total.half_cycles, 1u)));
+
+	const auto by_time = [] (const address_entry* lhs, const address_entry* rhs) { 
+		return lhs->cost.seconds > rhs->cost.seconds; 
+	};
+	static constexpr const char* columns = 
+		"count     time         ms  ns/half  half/in  waves/in groups/in flips/in\n";
+
+	std::vector<const address_entry*> entries;
+	for (auto&& entry : addresses)
+		if (entry.count)
+			entries.push_back (&entry);
+	std::sort (entries.begin (), entries.end (), by_time);
+	std::fprintf (file, "\n%-30s%s", "address", columns);
+	for (std::size_t i = 0u; i < std::min (rows, entries.size ()); ++i)
+	{
+		const auto where = std::size_t (entries [i] - addresses.data ());
+		std::fprintf (file, "$%04zx  %-12s", where, netlist_6502_opcode_names [entries [i]->opcode]);
+		report_entry (file, entries [i]->count, entries [i]->cost, seconds);
+	}
+
+	entries.clear ();
+	for (auto&& entry : opcodes)
+		if (entry.count)
+			entries.push_back (&entry);
+	std::sort (entries.begin (), entries.end (), by_time);
+	std::fprintf (file, "\n%-30s%s", "opcode", columns);
+	for (std::size_t i = 0u; i < std::min (rows, entries.size ()); ++i)
+	{
+		const auto which = std::size_t (entries [i] - opcodes);
+		std::fprintf (file, "%02zx     %-12s", which, netlist_6502_opcode_names [which]);
+		report_entry (file, entries [i]->count, entries [i]->cost, seconds);
+	}
+
+	std::vector<netlist_6502_profile_cost> costs;
+	inclusive (costs);
+	std::fprintf (file, "\n%-24s     calls  inclusive       self\n", "call tree");
+	report_node (file, costs, 0u, 0u, depth, seconds);
+}
+
+void netlist_6502_profile::report_node (std::FILE* file, const std::vector<netlist_6502_profile_cost>& costs, 
+	std::size_t node, std::size_t level, std::size_t depth, double total) const
+{
+	/* below half a percent only hides what matters */
+	if (level && costs [node].seconds * 200.0 < total)
+		return;
+
+	char name [64];
+	if (level)
+		std::snprintf (name, sizeof (name), "%*s$%04x", int (level * 2u), "", tree [node].address);
+	else
+		std::snprintf (name, sizeof (name), "all");
+	std::fprintf (file, "%-24s %10llu %8.2f %% %8.2f %%\n", name,
+		(unsigned long long)tree [node].calls, costs [node].seconds * 100.0 / total, tree [node].self.seconds * 100.0 / total);
+
+	if (level >= depth)
+		return;
+
+	auto children = tree [node].children;
+	std::sort (children.begin (), children.end (), [&costs] (auto lhs, auto rhs) { 
+		return costs [lhs].seconds > costs [rhs].seconds; 
+	});
+	for (auto child : children)
+		report_node (file, costs, child, level + 1u, depth, total);
+}
@@ -0,0 +1,111 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+#include "netlist_6502.hpp"
+
+/* what simulating a stretch of guest code cost */
+struct netlist_6502_profile_cost
+{
+	std::uint64_t half_cycles { 0u };
+	double seconds { 0.0 };
+	std::uint64_t waves { 0u };
+	std::uint64_t groups { 0u };
+	std::uint64_t nodes_flipped { 0u };
+
+	void add (const netlist_6502_profile_cost& other);
+};
+
+/*
+ * Attributes the cost of every half-cycle to the guest instruction that
+ * runs in it. An instruction starts when sync rises on its opcode fetch,
+ * the fetch address is the instruction's address, and it owns every
+ * half-cycle up to the next fetch.
+ *
+ * The call tree follows JSR and BRK into their targets. A call is left
+ * when the stack pointer climbs back to where it was before the call,
+ * so code that jumps through a pushed address and RTS, or resets the
+ * stack, still ends up in the right frame.
+ */
+struct netlist_6502_profile
+{
+	/* after every half-cycle, with the time eval() took for it */
+	void sample (const netlist_6502& cpu, const std::uint8_t* memory, double seconds);
+
+	/* flat profiles by address and by opcode, then the call tree down to depth */
+	void report (std::FILE* file, std::size_t rows, std::size_t depth) const;
+
+private:
+	struct address_entry
+	{
+		std::uint64_t count { 0u };
+		std::uint8_t opcode { 0u };
+		netlist_6502_profile_cost cost;
+	};
+
+	struct tree_node
+	{
+		std::uint16_t address;
+		std::size_t parent;
+		std::uint64_t calls { 0u };
+		netlist_6502_profile_cost self;
+		std::vector<std::size_t> children;
+	};
+
+	struct frame
+	{
+		std::size_t node;
+		std::uint8_t stack;
+	};
+
+	void start_instruction (const netlist_6502& cpu, const std::uint8_t* memory);
+	auto child (std::size_t parent, std::uint16_t address) -> std::size_t;
+	void inclusive (std::vector<netlist_6502_profile_cost>& costs) const;
+	void report_node (std::FILE* file, const std::vector<netlist_6502_profile_cost>& costs, 
+		std::size_t node, std::size_t level, std::size_t depth, double total) const;
+
+	std::vector<address_entry> addresses = std::vector<address_entry> (0x10000u);
+	address_entry opcodes [256];
+	std::vector<tree_node> tree { tree_node { 0u, 0u, 0u, {}, {} } };
+	std::unordered_map<std::uint64_t, std::size_t> tree_index;
+	std::vector<frame> frames;
+
+	/* the instruction running now, none before the first fetch */
+	bool started { false };
+	bool fetching { false };
+	std::uint16_t address { 0u };
+	std::uint8_t opcode { 0u };
+
+	/* a JSR or BRK whose target is the next fetch, and the stack pointer before it */
+	bool calling { false };
+	std::uint8_t calling_stack { 0u };
+
+	netlist_6502_counters last {};
+	netlist_6502_profile_cost total;
+	std::uint64_t instructions { 0u };
+};
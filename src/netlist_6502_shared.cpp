@@ -0,0 +1,261 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <new>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "netlist_6502.hpp"
+#include "netlist_6502_shared.hpp"
+
+static inline constexpr auto
+words_for (std::size_t bits) -> std::size_t
+{
+	return (bits + 63u) / 64u;
+}
+
+/* word by word as relaxed atomics, a copy torn by the writer is then thrown away and never a data race */
+static void
+store_words (std::uint64_t* to, const std::uint64_t* from, std::size_t count)
+{
+	for (std::size_t i = 0u; i < count; ++i)
+		std::atomic_ref<std::uint64_t> (to [i]).store (from [i], std::memory_order_relaxed);
+}
+
+static void
+load_words (std::uint64_t* to, std::uint64_t* from, std::size_t count)
+{
+	for (std::size_t i = 0u; i < count; ++i)
+		to [i] = std::atomic_ref<std::uint64_t> (from [i]).load (std::memory_order_relaxed);
+}
+
+#if !defined(_WIN32)
+/* shm_open wants a single leading slash */
+static void
+shared_name (char (&result) [256], const char* name)
+{
+	std::snprintf (result, sizeof (result), "%s%s", name [0] == '/' ? "" : "/", name);
+}
+#endif
+
+auto netlist_6502_shared::create (const char* name, std::size_t memory_bytes) -> std::unique_ptr<netlist_6502_shared>
+{
+	const auto node_words = words_for (netlist_6502::node_count ());
+	const auto transistor_words = words_for (netlist_6502::transistor_count ());
+
+	netlist_6502_shared_header layout {};
+	std::memcpy (layout.magic, netlist_6502_shared_magic, sizeof (layout.magic));
+	layout.version						= netlist_6502_shared_version;
+	layout.header_bytes				= std::uint32_t (sizeof (netlist_6502_shared_header));
+	layout.node_count					= std::uint32_t (netlist_6502::node_count ());
+	layout.transistor_count		= std::uint32_t (netlist_6502::transistor_count ());
+	layout.nodes_offset				= std::uint32_t (words_for (sizeof (netlist_6502_shared_header) * 8u) * 8u);
+	layout.transistors_offset	= std::uint32_t (layout.nodes_offset + node_words * 8u);
+	layout.memory_offset			= std::uint32_t (layout.transistors_offset + transistor_words * 8u);
+	layout.memory_bytes				= std::uint32_t (memory_bytes);
+
+	std::unique_ptr<netlist_6502_shared> result { new netlist_6502_shared };
+	result->size = layout.memory_offset + memory_bytes;
+	result->scratch.resize (node_words + transistor_words);
+
+#if defined(_WIN32)
+	std::snprintf (result->name, sizeof (result->name), "%s", name);
+	result->mapping = CreateFileMappingA (INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+		DWORD (std::uint64_t (result->size) >> 32u), DWORD (result->size), result->name);
+	if (!result->mapping)
+		return nullptr;
+	/* someone else's region, taking it over would pull it from under its readers */
+	if (GetLastError () == ERROR_ALREADY_EXISTS)
+	{
+		errno = EEXIST;
+		return nullptr;
+	}
+	result->base = MapViewOfFile (result->mapping, FILE_MAP_ALL_ACCESS, 0, 0, result->size);
+	if (!result->base)
+		return nullptr;
+#else
+	shared_name (result->name, name);
+	/* never truncate a live region, its readers would fault on their next access */
+	const auto fd = shm_open (result->name, O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0)
+		return nullptr;
+	if (ftruncate (fd, off_t (result->size)))
+	{
+		close (fd);
+		shm_unlink (result->name);
+		return nullptr;
+	}
+	auto* base = mmap (nullptr, result->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close (fd);
+	if (base == MAP_FAILED)
+	{
+		shm_unlink (result->name);
+		return nullptr;
+	}
+	result->base = base;
+#endif
+	result->owner = true;
+
+	/* the magic goes in last, a tool that sees it sees a complete header */
+	auto* header = new (result->base) netlist_6502_shared_header {};
+	header->version							= layout.version;
+	header->header_bytes				= layout.header_bytes;
+	header->node_count					= layout.node_count;
+	header->transistor_count		= layout.transistor_count;
+	header->nodes_offset				= layout.nodes_offset;
+	header->transistors_offset	= layout.transistors_offset;
+	header->memory_offset				= layout.memory_offset;
+	header->memory_bytes				= layout.memory_bytes;
+	std::atomic_thread_fence (std::memory_order_release);
+	std::memcpy (header->magic, layout.magic, sizeof (layout.magic));
+
+	return result;
+}
+
+auto netlist_6502_shared::open (const char* name) -> std::unique_ptr<netlist_6502_shared>
+{
+	std::unique_ptr<netlist_6502_shared> result { new netlist_6502_shared };
+
+#if defined(_WIN32)
+	std::snprintf (result->name, sizeof (result->name), "%s", name);
+	result->mapping = OpenFileMappingA (FILE_MAP_READ, FALSE, result->name);
+	if (!result->mapping)
+		return nullptr;
+	result->base = MapViewOfFile (result->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!result->base)
+		return nullptr;
+	MEMORY_BASIC_INFORMATION info {};
+	VirtualQuery (result->base, &info, sizeof (info));
+	result->size = info.RegionSize;
+#else
+	shared_name (result->name, name);
+	const auto fd = shm_open (result->name, O_RDONLY, 0);
+	if (fd < 0)
+		return nullptr;
+	struct stat st {};
+	if (fstat (fd, &st) || std::size_t (st.st_size) < sizeof (netlist_6502_shared_header))
+	{
+		close (fd);
+		return nullptr;
+	}
+	result->size = std::size_t (st.st_size);
+	auto* base = mmap (nullptr, result->size, PROT_READ, MAP_SHARED, fd, 0);
+	close (fd);
+	if (base == MAP_FAILED)
+		return nullptr;
+	result->base = base;
+#endif
+
+	const auto& header = result->header ();
+	if (std::memcmp (header.magic, netlist_6502_shared_magic, sizeof (header.magic)) ||
+		header.version != netlist_6502_shared_version ||
+		header.nodes_offset + words_for (header.node_count) * 8u > header.transistors_offset ||
+		header.transistors_offset + words_for (header.transistor_count) * 8u > header.memory_offset ||
+		header.memory_offset + std::size_t (header.memory_bytes) > result->size)
+		return nullptr;
+
+	return result;
+}
+
+netlist_6502_shared::~netlist_6502_shared ()
+{
+#if defined(_WIN32)
+	if (base)
+		UnmapViewOfFile (base);
+	if (mapping)
+		CloseHandle (mapping);
+#else
+	if (base)
+		munmap (base, size);
+	if (owner)
+		shm_unlink (name);
+#endif
+}
+
+void netlist_6502_shared::publish (const netlist_6502& nlsym)
+{
+	auto& header = *static_cast<netlist_6502_shared_header*> (base);
+	const auto node_words = words_for (header.node_count);
+	auto* nodes = scratch.data ();
+	auto* transistors = nodes + node_words;
+	nlsym.copy_nodes (nodes);
+	nlsym.copy_transistors (transistors);
+
+	const auto generation = header.generation.load (std::memory_order_relaxed);
+
+	/* odd while the words are being written */
+	header.generation.store (generation + 1u, std::memory_order_relaxed);
+	std::atomic_thread_fence (std::memory_order_release);
+	store_words (words (header.nodes_offset), nodes, node_words);
+	store_words (words (header.transistors_offset), transistors, words_for (header.transistor_count));
+	header.generation.store (generation + 2u, std::memory_order_release);
+}
+
+auto netlist_6502_shared::read (std::uint64_t* nodes, std::uint64_t* transistors) const -> std::uint64_t
+{
+	const auto& header = this->header ();
+	for (;;)
+	{
+		const auto before = header.generation.load (std::memory_order_acquire);
+		if (before & 1u)
+			continue;
+		load_words (nodes, words (header.nodes_offset), words_for (header.node_count));
+		load_words (transistors, words (header.transistors_offset), words_for (header.transistor_count));
+		std::atomic_thread_fence (std::memory_order_acquire);
+		if (header.generation.load (std::memory_order_relaxed) == before)
+			return before / 2u;
+	}
+}
+
+auto netlist_6502_shared::header () const -> const netlist_6502_shared_header&
+{
+	return *static_cast<const netlist_6502_shared_header*> (base);
+}
+
+/* not const, atomic_ref wants it so even to load, the words are only ever loaded through a read-only mapping */
+auto netlist_6502_shared::words (std::uint32_t offset) const -> std::uint64_t*
+{
+	return reinterpret_cast<std::uint64_t*> (static_cast<std::uint8_t*> (base) + offset);
+}
+
+auto netlist_6502_shared::memory () const -> const std::uint8_t*
+{
+	return static_cast<const std::uint8_t*> (base) + header ().memory_offset;
+}
+
+auto netlist_6502_shared::writable_memory () -> std::uint8_t*
+{
+	return owner ? static_cast<std::uint8_t*> (base) + header ().memory_offset : nullptr;
+}
@@ -0,0 +1,117 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct netlist_6502;
+
+/*
+ * A named shared memory region with the live state of a machine, for
+ * visualisers and analysis tools running as separate processes. It is
+ * laid out as
+ *
+ *   header
+ *   node values             one bit per node, in 64 bit words
+ *   conducting transistors  one bit per transistor, in 64 bit words
+ *   guest memory
+ *
+ * with all offsets in the header. The node and transistor bits change
+ * together under the generation counter, which is odd while they are
+ * being written, and are written and read as relaxed atomic words: a
+ * reader copies them between two equal even reads of it and retries
+ * otherwise, read () does just that. The guest memory is the emulator's
+ * own RAM, it is always live and not covered by the counter.
+ *
+ * Nothing in the region is a pointer, a tool maps it wherever it likes.
+ */
+
+static inline constexpr char netlist_6502_shared_magic [8] = { 'P', '6', '5', '0', '2', 'S', 'H', 'M' };
+static inline constexpr std::uint32_t netlist_6502_shared_version = 1u;
+
+struct netlist_6502_shared_header
+{
+	char magic [8];
+	std::uint32_t version;
+	std::uint32_t header_bytes;
+	std::uint32_t node_count;
+	std::uint32_t transistor_count;
+	std::uint32_t nodes_offset;
+	std::uint32_t transistors_offset;
+	std::uint32_t memory_offset;
+	std::uint32_t memory_bytes;
+	std::atomic<std::uint64_t> generation;
+};
+
+static_assert (std::atomic<std::uint64_t>::is_always_lock_free, "the generation counter is shared between processes");
+static_assert (std::atomic_ref<std::uint64_t>::is_always_lock_free, "the node and transistor words are shared between processes");
+
+struct netlist_6502_shared
+{
+	/*
+	 * creates the region for a simulator, null when that isn't possible,
+	 * with errno EEXIST when the name is already taken
+	 */
+	static auto create (const char* name, std::size_t memory_bytes) -> std::unique_ptr<netlist_6502_shared>;
+
+	/* maps an existing region read-only for a tool, null when there is none or it doesn't match */
+	static auto open (const char* name) -> std::unique_ptr<netlist_6502_shared>;
+
+	netlist_6502_shared (const netlist_6502_shared&) = delete;
+	netlist_6502_shared& operator = (const netlist_6502_shared&) = delete;
+	~netlist_6502_shared ();
+
+	/* copies the node values and transistor states of the machine in */
+	void publish (const netlist_6502& nlsym);
+
+	/*
+	 * a consistent copy of the node values and transistor states, in as
+	 * many words as the header says, retried until no publish () got in
+	 * between, returns how many publish () calls it reflects
+	 */
+	auto read (std::uint64_t* nodes, std::uint64_t* transistors) const -> std::uint64_t;
+
+	auto header	() const -> const netlist_6502_shared_header&;
+	auto memory	() const -> const std::uint8_t*;
+
+	/* the guest memory for the simulator to run on, null in a region mapped with open () */
+	auto writable_memory () -> std::uint8_t*;
+
+private:
+	netlist_6502_shared () = default;
+
+	auto words (std::uint32_t offset) const -> std::uint64_t*;
+
+	void* base { nullptr };
+	std::size_t size { 0u };
+	bool owner { false };
+	/* the words publish () takes from the machine before they go in */
+	std::vector<std::uint64_t> scratch;
+	char name [256] {};
+#if defined(_WIN32)
+	void* mapping { nullptr };
+#endif
+};
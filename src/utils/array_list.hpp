@@ -163,6 +163,10 @@ struct array_list
 		return &_data[size()];
 	}
 
+	/* raw storage, for code that appends on its own and keeps the size up to date */
+	constexpr auto* data() { return _data; }
+	constexpr auto* size_data() { return &_size; }
+
 	constexpr auto indexes() const 
 	{
 		return range<std::size_t> { 0u, size() };
@@ -64,7 +64,14 @@ struct array_set
 
 	constexpr void clear()
 	{
-		marks.clear();
+		/* a handful of elements is cheaper to unmark than the whole bitmap */
+		if (store.size() < marks.num_words)
+		{
+			for (auto&& v : store)
+				marks.set(v, false);
+		}
+		else
+			marks.clear();
 		store.clear();
 	}
 
@@ -88,6 +95,11 @@ struct array_set
 		return marks.get(v);
 	}
 
+	/* raw storage, for code that inserts on its own and keeps marks and list in step */
+	constexpr auto* marks_data() { return marks.data(); }
+	constexpr auto* items_data() { return store.data(); }
+	constexpr auto* size_data() { return store.size_data(); }
+
 	auto&& as_array() const { return store; }
 	auto&& as_bitmap()	const { return marks; }
 
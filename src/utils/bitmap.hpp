@@ -25,6 +25,8 @@
 #include <cstddef>
 #include <cstdint>
 #include <utility>
+#include <array>
+#include <bit>
 #include <initializer_list>
 #include <algorithm>
 
@@ -40,6 +42,7 @@ struct bitmap
 
 	constexpr bitmap(): store { 0u } {}
 	constexpr bitmap(const bitmap& prev): bitmap(prev, std::make_index_sequence<num_words>{}) {}
+	constexpr bitmap& operator = (const bitmap&) = default;
 	constexpr bitmap(const int (&values) [num_bits])
 	: store { 0u }
 	{
@@ -85,6 +88,18 @@ struct bitmap
 
 	static constexpr auto size() { return num_bits ; }
 
+	constexpr bool intersects(const bitmap& other) const
+	{
+		for (std::size_t i = 0u; i < num_words; ++i)
+			if (store [i] & other.store [i])
+				return true;
+		return false;
+	}
+
+	constexpr auto word(std::size_t index) const -> word_type { return store [index]; }
+	constexpr auto data() -> word_type* { return store; }
+	constexpr auto data() const -> const word_type* { return store; }
+
 	constexpr auto clear() 
 	{
 		for (auto&& cell : store) 
@@ -97,50 +112,29 @@ struct bitmap
 	{
 		if constexpr (sizeof...(_Index) == 1u)
 			return get(_Index...);
-		else if constexpr (is_aligned_single_byte<_Index...>())
-		{
-			static constexpr auto bits_index = get_first_index<_Index...>();
-			static constexpr auto word_index = bits_index / word_size;
-			static constexpr auto word_shift = bits_index % word_size;
-			return _New_type ((store[word_index] >> word_shift) & 0xffu);
-		}
 		else
 		{
-			auto value = _New_type { 0u };
-			static constexpr auto q = sizeof...(_Index) - 1u;
-			for (const auto index : { _Index ... })
+			constexpr auto&& plan = bits_plan<_Index...>;
+			return [&] <std::size_t... _Segment> (std::index_sequence<_Segment...>)
 			{
-				value >>= 1u;
-				value |= (get (index) << q);
-			}
-			return value;		
+				return _New_type ((gather_segment (plan.first [_Segment]) | ... | std::uint64_t { 0u }));
+			} (std::make_index_sequence<plan.second> {});
 		}
 	}
 
 	template <auto... _Index, typename _New_type>
 	requires (sizeof... (_Index) <= sizeof (_New_type) * 8 && sizeof... (_Index) >= 1u)
-	constexpr auto set_bits(_New_type value) 
+	constexpr void set_bits(_New_type value) 
 	{
 		if constexpr (sizeof...(_Index) == 1u)
 			set(_Index..., value);
-		else if constexpr (is_aligned_single_byte<_Index...>())
-		{
-			static constexpr auto bits_index = get_first_index<_Index...>();
-			static constexpr auto word_index = bits_index / word_size;
-			static constexpr auto word_shift = bits_index % word_size;
-			static constexpr auto mask = word_type{ 0xffu } << word_shift;
-			store[word_index] = (store[word_index] & ~mask) | ((word_type { value } << word_shift) & mask);
-		}
 		else
 		{
-			auto value = _New_type { 0u };
-			static constexpr auto q = sizeof...(_Index) - 1u;
-			for (const auto index : { _Index ... })
+			constexpr auto&& plan = bits_plan<_Index...>;
+			[&] <std::size_t... _Segment> (std::index_sequence<_Segment...>)
 			{
-				value >>= 1u;
-				value |= (get (index) << q);
-			}
-			return value;		
+				(scatter_segment (plan.first [_Segment], std::uint64_t (value)), ...);
+			} (std::make_index_sequence<plan.second> {});
 		}
 	}
 
@@ -150,6 +144,84 @@ private:
 	template <std::size_t ... I>
 	constexpr bitmap(const bitmap& prev, std::index_sequence<I...>): store { prev.store[I]... } {}
 
+	/*
+	 * A multi-bit access is split at compile time into segments, each
+	 * covering bits of one storage word whose order in the word agrees
+	 * with their order in the value. A segment whose bits form a single
+	 * run on both sides (and all of a byte aligned register) is a plain
+	 * shift, anything else is an extract / deposit pair.
+	 */
+	struct bits_segment
+	{
+		std::size_t		word { 0u };
+		word_type			store_mask { 0u };
+		std::uint64_t	value_mask { 0u };
+		int						shift { 0 };
+		bool					contiguous { false };
+		std::size_t		last_bit { 0u };
+	};
+
+	template <auto... _Index>
+	static constexpr auto make_bits_plan()
+	{
+		constexpr std::size_t index [] = { std::size_t (_Index % num_bits)... };
+		bits_segment segments [sizeof... (_Index)] {};
+		std::size_t count { 0u };
+
+		for (std::size_t i = 0u; i < sizeof... (_Index); ++i)
+		{
+			const auto word = index [i] / word_size;
+			const auto bit = index [i] % word_size;
+			auto j = 0u;
+			while (j < count && (segments [j].word != word || segments [j].last_bit >= bit))
+				++j;
+			if (j == count)
+				segments [count++].word = word;
+			segments [j].store_mask |= word_type (1) << bit;
+			segments [j].value_mask |= std::uint64_t (1) << i;
+			segments [j].last_bit = bit;
+		}
+
+		std::array<bits_segment, sizeof... (_Index)> plan {};
+		for (std::size_t j = 0u; j < count; ++j)
+		{
+			auto segment = segments [j];
+			const auto store_low = std::countr_zero (segment.store_mask);
+			const auto value_low = std::countr_zero (segment.value_mask);
+			segment.contiguous = 
+				is_contiguous_mask (segment.store_mask) && 
+				is_contiguous_mask (segment.value_mask);
+			segment.shift = store_low - value_low;
+			plan [j] = segment;
+		}
+		return std::pair { plan, count };
+	}
+
+	template <auto... _Index>
+	static inline constexpr auto bits_plan = make_bits_plan<_Index...> ();
+
+	constexpr auto gather_segment(const bits_segment& segment) const -> std::uint64_t
+	{
+		const auto bits = std::uint64_t (store [segment.word] & segment.store_mask);
+		if (!segment.contiguous)
+			return bit_deposit (bit_extract (bits, segment.store_mask), segment.value_mask);
+		if (segment.shift >= 0)
+			return bits >> segment.shift;
+		return bits << -segment.shift;
+	}
+
+	constexpr void scatter_segment(const bits_segment& segment, std::uint64_t value)
+	{
+		auto bits = value & segment.value_mask;
+		if (!segment.contiguous)
+			bits = bit_deposit (bit_extract (bits, segment.value_mask), segment.store_mask);
+		else if (segment.shift >= 0)
+			bits <<= segment.shift;
+		else
+			bits >>= -segment.shift;
+		auto&& cell = store [segment.word];
+		cell = (cell & ~segment.store_mask) | (word_type (bits) & segment.store_mask);
+	}
 
 	word_type store [num_words];
 };
\ No newline at end of file
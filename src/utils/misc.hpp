@@ -23,6 +23,15 @@
 #pragma once
 
 #include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__) && defined(_M_X64))
+#define PERFECT6502_HAS_BMI2 1
+#include <immintrin.h>
+#else
+#define PERFECT6502_HAS_BMI2 0
+#endif
 
 template <typename Q, typename ... U>
 inline constexpr auto one_of(Q&& q, U&&... u)
@@ -43,32 +52,48 @@ inline void inplace_max(U& u, Q&& q)
 		std::swap(q, u);
 }
 
-template <typename... _Index>
-inline constexpr auto is_aligned_single_byte(_Index&&... index)
+/*
+ * Gather the bits of value selected by mask into the low bits of
+ * the result (PEXT), and the inverse scatter (PDEP). With BMI2 these
+ * are single instructions, otherwise we walk the mask one bit at a
+ * time.
+ */
+inline constexpr auto bit_extract(std::uint64_t value, std::uint64_t mask) -> std::uint64_t
 {
-	using value_type = std::tuple_element_t<0, std::tuple<_Index...>>;
-	value_type index_array [] = { index... };
-
-	if (sizeof...(_Index) != 8u)
-		return false;
-	if (index_array [0] % 8)
-		return false;
-	for(auto i = 0u; i < sizeof...(_Index) - 1; ++i)
-		if ((index_array[i + 1] - index_array[i]) != 1)
-			return false;
-	return true;
+#if PERFECT6502_HAS_BMI2
+	if (!std::is_constant_evaluated())
+		return _pext_u64(value, mask);
+#endif
+	std::uint64_t result { 0u };
+	for (std::uint64_t bit { 1u }; mask != 0u; bit <<= 1u)
+	{
+		if (value & mask & -mask)
+			result |= bit;
+		mask &= mask - 1u;
+	}
+	return result;
 }
 
-template <auto... _Index>
-inline constexpr auto is_aligned_single_byte()
+inline constexpr auto bit_deposit(std::uint64_t value, std::uint64_t mask) -> std::uint64_t
 {
-	return is_aligned_single_byte(_Index...);
+#if PERFECT6502_HAS_BMI2
+	if (!std::is_constant_evaluated())
+		return _pdep_u64(value, mask);
+#endif
+	std::uint64_t result { 0u };
+	for (std::uint64_t bit { 1u }; mask != 0u; bit <<= 1u)
+	{
+		if (value & bit)
+			result |= mask & -mask;
+		mask &= mask - 1u;
+	}
+	return result;
 }
 
-
-template <auto _First, auto... _Rest>
-inline constexpr auto get_first_index()
+inline constexpr auto is_contiguous_mask(std::uint64_t mask)
 {
-	return _First;
+	if (mask == 0u)
+		return false;
+	const auto low = mask & -mask;
+	return ((mask + low) & mask) == 0u;
 }
-
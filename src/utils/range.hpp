@@ -22,6 +22,9 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
+
 template <typename Q>
 struct range
 {
@@ -164,3 +167,44 @@ private:
 
 template <typename _Array, typename _Lhs, typename _Rhs>
 indexed_range(_Array&, _Lhs&&, _Rhs&&) -> indexed_range<_Array, std::common_type_t<_Lhs, _Rhs>>;
+
+
+/* fixed size records packed back to back in a flat array, read by value */
+template <typename _Value, std::size_t _Stride>
+struct strided_range
+{
+	using value_type = std::array<_Value, _Stride>;
+
+	struct iterator
+	{
+		constexpr iterator(const _Value* _at): _at{ _at } {}
+
+		constexpr auto operator * () const 
+		{
+			value_type record {};
+			for (std::size_t i = 0u; i < _Stride; ++i)
+				record [i] = _at [i];
+			return record;
+		}
+
+		constexpr auto& operator ++ () { _at += _Stride; return *this; }
+		constexpr bool operator == (const iterator& rhs) const { return _at == rhs._at; }
+
+	private:
+		const _Value* _at;
+	};
+
+	constexpr strided_range(const _Value* _first, std::size_t _count)
+	: _first	{ _first },
+		_last		{ _first + _count * _Stride }
+	{}
+
+	constexpr auto begin()	const { return iterator( _first	)	;	}
+	constexpr auto end()		const { return iterator( _last	)	;	}
+	constexpr auto cbegin() const { return iterator( _first	)	;	}
+	constexpr auto cend()		const { return iterator( _last	)	;	}
+
+private:
+	const _Value* _first;
+	const _Value* _last;
+};
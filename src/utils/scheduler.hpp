@@ -0,0 +1,214 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+/*
+ * Runs many coroutines on a few threads. Every worker has a queue of its
+ * own: it resumes the oldest coroutine in it and, when it runs dry,
+ * steals the newest from another worker. A coroutine scheduled from a
+ * worker goes to that worker's queue, from any other thread to the
+ * queues in turn.
+ *
+ * Coroutines are scheduler_task, started by spawn() and gone when they
+ * return. They give the worker back with co_await yield(), or park
+ * themselves in an awaitable of their own and get schedule()d later by
+ * whoever has what they wait for. Coroutines still queued when the
+ * scheduler goes away are destroyed with it, parked ones belong to
+ * whoever parked them.
+ *
+ * A worker with nothing to do sleeps on a semaphore of its own. It says
+ * so before it looks at the count of queued coroutines one last time,
+ * and schedule() bumps that count before it looks for a sleeper, so one
+ * of the two always sees the other: schedule() never takes a lock but
+ * its queue's and only wakes a worker when one is asleep.
+ */
+struct scheduler_task
+{
+	struct promise_type
+	{
+		auto get_return_object () -> scheduler_task { return { std::coroutine_handle<promise_type>::from_promise (*this) }; }
+		auto initial_suspend () -> std::suspend_always { return {}; }
+		auto final_suspend () noexcept -> std::suspend_never { return {}; }
+		void return_void () {}
+		void unhandled_exception () { std::terminate (); }
+	};
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+struct scheduler
+{
+	explicit scheduler (std::size_t workers)
+	{
+		for (std::size_t i = 0u; i < workers; ++i)
+			queues.push_back (std::make_unique<queue_type> ());
+		for (std::size_t i = 0u; i < workers; ++i)
+			threads.emplace_back ([this, i] { work (i); });
+	}
+
+	~scheduler ()
+	{
+		stopping.store (true);
+		for (auto&& queue : queues)
+			if (queue->asleep.exchange (false))
+				queue->wake.release ();
+		for (auto&& thread : threads)
+			thread.join ();
+
+		for (auto&& queue : queues)
+			for (auto handle : queue->handles)
+				handle.destroy ();
+	}
+
+	scheduler (const scheduler&) = delete;
+	scheduler& operator = (const scheduler&) = delete;
+
+	void spawn (scheduler_task task)
+	{
+		schedule (task.handle);
+	}
+
+	/* from any thread */
+	void schedule (std::coroutine_handle<> handle)
+	{
+		const auto index = current.owner == this 
+			? current.index 
+			: next_queue.fetch_add (1u, std::memory_order_relaxed) % queues.size ();
+		{
+			std::lock_guard guard { queues [index]->lock };
+			queues [index]->handles.push_back (handle);
+		}
+		queued.fetch_add (1u);
+
+		if (sleepers.load () == 0u)
+			return;
+		/* the worker of that queue if it sleeps, any other that does otherwise, it steals */
+		for (std::size_t i = 0u; i < queues.size (); ++i)
+		{
+			auto&& queue = *queues [(index + i) % queues.size ()];
+			if (queue.asleep.load () && queue.asleep.exchange (false))
+			{
+				queue.wake.release ();
+				return;
+			}
+		}
+	}
+
+	/* to the back of the line, behind everything queued on this worker */
+	auto yield ()
+	{
+		struct awaiter
+		{
+			scheduler& owner;
+			bool await_ready () const noexcept { return false; }
+			void await_suspend (std::coroutine_handle<> handle) { owner.schedule (handle); }
+			void await_resume () const noexcept {}
+		};
+		return awaiter { *this };
+	}
+
+private:
+	struct queue_type
+	{
+		std::mutex lock;
+		std::deque<std::coroutine_handle<>> handles;
+
+		/* set by the worker before it sleeps, cleared by whoever wakes it */
+		std::atomic<bool> asleep { false };
+		std::binary_semaphore wake { 0 };
+	};
+
+	/* which scheduler and queue the running thread works for */
+	struct current_type
+	{
+		scheduler* owner;
+		std::size_t index;
+	};
+	static inline thread_local current_type current {};
+
+	auto take (std::size_t index) -> std::coroutine_handle<>
+	{
+		for (std::size_t i = 0u; i < queues.size (); ++i)
+		{
+			auto&& queue = *queues [(index + i) % queues.size ()];
+			std::lock_guard guard { queue.lock };
+			if (queue.handles.empty ())
+				continue;
+			/* the oldest of our own, the newest of someone else's */
+			std::coroutine_handle<> handle;
+			if (i == 0u)
+			{
+				handle = queue.handles.front ();
+				queue.handles.pop_front ();
+			}
+			else
+			{
+				handle = queue.handles.back ();
+				queue.handles.pop_back ();
+			}
+			queued.fetch_sub (1u);
+			return handle;
+		}
+		return nullptr;
+	}
+
+	void work (std::size_t index)
+	{
+		current = { this, index };
+		auto&& own = *queues [index];
+		while (!stopping.load ())
+		{
+			if (const auto handle = take (index))
+			{
+				handle.resume ();
+				continue;
+			}
+
+			own.asleep.store (true);
+			sleepers.fetch_add (1u);
+			/* a schedule() that came in since take() either shows up here or has seen us asleep */
+			if ((queued.load () == 0u && !stopping.load ()) || !own.asleep.exchange (false))
+				own.wake.acquire ();
+			sleepers.fetch_sub (1u);
+		}
+	}
+
+	std::vector<std::unique_ptr<queue_type>> queues;
+	std::vector<std::thread> threads;
+	std::atomic<std::size_t> next_queue { 0u };
+
+	/* coroutines in the queues, and workers asleep or about to be */
+	std::atomic<std::size_t> queued { 0u };
+	std::atomic<std::size_t> sleepers { 0u };
+	std::atomic<bool> stopping { false };
+};
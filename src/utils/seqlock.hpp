@@ -0,0 +1,95 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/*
+ * Single writer, many readers. The writer never waits: it fills the
+ * slot readers aren't pointed at, then points them at it. A reader
+ * copies the slot it is pointed at and retries only when the writer
+ * came around to that very slot while it was copying, which takes two
+ * publications in the meantime.
+ *
+ * The value is kept in relaxed atomic words, so a torn copy is merely
+ * thrown away and never a data race.
+ */
+template <typename _Value>
+requires std::is_trivially_copyable_v<_Value>
+struct seqlock
+{
+	static inline constexpr auto num_words = (sizeof (_Value) + sizeof (std::uint64_t) - 1u) / sizeof (std::uint64_t);
+
+	void publish (const _Value& value)
+	{
+		std::uint64_t words [num_words] {};
+		std::memcpy (words, &value, sizeof (value));
+
+		const auto index = latest.load (std::memory_order_relaxed) ^ 1u;
+		auto&& slot = slots [index];
+		const auto sequence = slot.sequence.load (std::memory_order_relaxed);
+
+		/* odd while the slot is being written */
+		slot.sequence.store (sequence + 1u, std::memory_order_relaxed);
+		std::atomic_thread_fence (std::memory_order_release);
+		for (std::size_t i = 0u; i < num_words; ++i)
+			slot.words [i].store (words [i], std::memory_order_relaxed);
+		slot.sequence.store (sequence + 2u, std::memory_order_release);
+
+		latest.store (index, std::memory_order_release);
+	}
+
+	auto read () const -> _Value
+	{
+		std::uint64_t words [num_words] {};
+		for (;;)
+		{
+			auto&& slot = slots [latest.load (std::memory_order_acquire)];
+			const auto before = slot.sequence.load (std::memory_order_acquire);
+			if (before & 1u)
+				continue;
+			for (std::size_t i = 0u; i < num_words; ++i)
+				words [i] = slot.words [i].load (std::memory_order_relaxed);
+			std::atomic_thread_fence (std::memory_order_acquire);
+			if (slot.sequence.load (std::memory_order_relaxed) == before)
+				break;
+		}
+
+		_Value value;
+		std::memcpy (&value, words, sizeof (value));
+		return value;
+	}
+
+private:
+	struct alignas (64) slot_type
+	{
+		std::atomic<std::uint64_t> sequence { 0u };
+		std::atomic<std::uint64_t> words [num_words] {};
+	};
+
+	slot_type slots [2];
+	alignas (64) std::atomic<std::size_t> latest { 0u };
+};
@@ -0,0 +1,108 @@
+﻿/*
+ Copyright (c) 2021 Aleksandr Ševčenko
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+/*
+ * Single producer, single consumer, lock-free. Each side owns one index
+ * and only reads the other, so neither ever waits on the other or makes
+ * a system call: a full ring refuses a push, an empty one a pop. Each
+ * side keeps a copy of the other's index and only reloads it when that
+ * copy says the ring is full or empty, so the indices' cache lines
+ * don't bounce on every element.
+ */
+template <typename _Value, std::size_t _Capacity>
+requires (std::is_trivially_copyable_v<_Value> && _Capacity != 0u && (_Capacity & (_Capacity - 1u)) == 0u)
+struct spsc_ring
+{
+	static constexpr auto capacity () { return _Capacity; }
+
+	/* producer side, as many of the values as fit, returns how many */
+	auto push (const _Value* values, std::size_t count) -> std::size_t
+	{
+		const auto tail = producer.index.load (std::memory_order_relaxed);
+		if (_Capacity - (tail - producer.cached) < count)
+			producer.cached = consumer.index.load (std::memory_order_acquire);
+		count = std::min (count, _Capacity - (tail - producer.cached));
+		for (std::size_t i = 0u; i < count; ++i)
+			store [(tail + i) & (_Capacity - 1u)] = values [i];
+		producer.index.store (tail + count, std::memory_order_release);
+		return count;
+	}
+
+	bool push (const _Value& value)
+	{
+		return push (&value, 1u) == 1u;
+	}
+
+	/* consumer side, as many values as are there up to count, returns how many */
+	auto pop (_Value* values, std::size_t count) -> std::size_t
+	{
+		const auto head = consumer.index.load (std::memory_order_relaxed);
+		if (consumer.cached - head < count)
+			consumer.cached = producer.index.load (std::memory_order_acquire);
+		count = std::min (count, consumer.cached - head);
+		for (std::size_t i = 0u; i < count; ++i)
+			values [i] = store [(head + i) & (_Capacity - 1u)];
+		consumer.index.store (head + count, std::memory_order_release);
+		return count;
+	}
+
+	bool pop (_Value& value)
+	{
+		return pop (&value, 1u) == 1u;
+	}
+
+	/* producer side */
+	bool full ()
+	{
+		const auto tail = producer.index.load (std::memory_order_relaxed);
+		if (tail - producer.cached == _Capacity)
+			producer.cached = consumer.index.load (std::memory_order_acquire);
+		return tail - producer.cached == _Capacity;
+	}
+
+	/* consumer side */
+	bool empty ()
+	{
+		const auto head = consumer.index.load (std::memory_order_relaxed);
+		if (consumer.cached == head)
+			consumer.cached = producer.index.load (std::memory_order_acquire);
+		return consumer.cached == head;
+	}
+
+private:
+	/* the index a side writes, and its latest copy of the other side's */
+	struct alignas (64) side_type
+	{
+		std::atomic<std::size_t> index { 0u };
+		std::size_t cached { 0u };
+	};
+
+	side_type producer;
+	side_type consumer;
+	_Value store [_Capacity];
+};